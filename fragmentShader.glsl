@@ -1,11 +1,42 @@
 #version 330 core
 
-uniform sampler2D texSample;
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
+#define DISPLAY_PLANES 4
+
+// Bit-packed rows, one byte per texel: frame (0 = latest, 1 = previous), then plane, then row.
+// Each row is a little-endian 128-bit word with the leftmost pixel in its top bit.
+uniform usampler2D planes;
+uniform vec3 palette[1 << DISPLAY_PLANES];
+uniform float blend;
+
+// MegaChip frames arrive already resolved to RGBA, and are only faded by the screen alpha
+uniform bool mega;
+uniform sampler2D megaFrame;
+uniform float megaAlpha;
 
 in vec2 texCoord;
 
 out vec4 fragCol;
 
+int paletteIndex(int frame, ivec2 pixel) {
+  int column = DISPLAY_WIDTH / 8 - 1 - pixel.x / 8;
+  uint bit = uint(7 - pixel.x % 8);
+  int index = 0;
+  for (int p = 0; p < DISPLAY_PLANES; p++) {
+    uint bits = texelFetch(planes, ivec2(column, (frame * DISPLAY_PLANES + p) * DISPLAY_HEIGHT + pixel.y), 0).r;
+    index |= int((bits >> bit) & 1u) << p;
+  }
+  return index;
+}
+
 void main() {
-  fragCol = texture(texSample, texCoord);
+  if (mega) {
+    fragCol = vec4(texture(megaFrame, texCoord).rgb * megaAlpha, 1.0f);
+    return;
+  }
+  ivec2 pixel = min(ivec2(texCoord * vec2(DISPLAY_WIDTH, DISPLAY_HEIGHT)), ivec2(DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1));
+  vec3 previous = palette[paletteIndex(1, pixel)];
+  vec3 latest = palette[paletteIndex(0, pixel)];
+  fragCol = vec4(mix(previous, latest, blend), 1.0f);
 }
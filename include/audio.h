@@ -0,0 +1,77 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <cstdint>
+#include <fstream>
+
+#define SAMPLE_RATE 44100                 // Emulated sample clock, and the default output rate
+#define AUDIO_BLOCK 256                   // Samples rendered per streaming buffer
+#define AUDIO_BUFFERS 3                   // Streaming buffers queued on the source
+
+// Where the buzzer's samples go. Realtime backends play on a device clock, and the buzzer's
+// audio thread keeps them fed; offline backends are written as emulated time advances, so
+// their output is aligned to the emulated clock however fast emulation runs.
+class AudioBackend {
+  public:
+    virtual ~AudioBackend() {};
+    virtual unsigned SampleRate() = 0;
+    virtual bool Realtime() { return false; };
+    // Offline backends that throw samples away, so the buzzer can skip synthesis entirely
+    virtual bool Discards() { return false; };
+    // Realtime: samples that can be written without blocking
+    virtual int Free() { return 0; };
+    virtual void Write(const int16_t *samples, int count) = 0;
+    // Realtime: total samples the device has played so far, when it is playing
+    virtual bool Played(uint64_t *samples) { return false; };
+};
+
+// Streams through an OpenAL buffer queue. Ready() is false when no device could be opened.
+class OpenALBackend : public AudioBackend {
+  private:
+    ALCdevice *device;
+    ALCcontext *context;
+    ALuint source;
+    ALuint buffers[AUDIO_BUFFERS];
+    uint64_t written;
+
+    void Close();
+
+  public:
+    OpenALBackend();
+    ~OpenALBackend();
+    bool Ready() { return device != NULL; };
+    unsigned SampleRate() override { return SAMPLE_RATE; };
+    bool Realtime() override { return true; };
+    int Free() override;
+    void Write(const int16_t *samples, int count) override;
+    bool Played(uint64_t *samples) override;
+};
+
+// Discards everything; used headless and when no audio device is available
+class NullBackend : public AudioBackend {
+  public:
+    unsigned SampleRate() override { return SAMPLE_RATE; };
+    bool Discards() override { return true; };
+    void Write(const int16_t *samples, int count) override {};
+};
+
+// Writes 16-bit mono PCM to a WAV file at any sample rate; the header is completed on close
+class WavBackend : public AudioBackend {
+  private:
+    std::ofstream file;
+    unsigned sampleRate;
+    uint32_t dataBytes;
+
+    void WriteHeader();
+
+  public:
+    WavBackend(const char *path, unsigned sampleRate);
+    ~WavBackend();
+    bool Ready() { return file.is_open(); };
+    unsigned SampleRate() override { return sampleRate; };
+    void Write(const int16_t *samples, int count) override;
+};
+
+#endif
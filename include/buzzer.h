@@ -1,24 +1,128 @@
 #ifndef BUZZER_H
 #define BUZZER_H
 
-#include <AL/al.h>
-#include <AL/alc.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "audio.h"
+#include "pattern.h"
+#include "sampler.h"
+#include "synth.h"
 
-#define SAMPLE_RATE 44100
 #define FREQUENCY 220
-#define NUM_SAMPLES SAMPLE_RATE
+#define VOLUME 0.5f
+#define AUDIO_LATENCY 768                 // Target lead of emulated time over the playback position (~2 emulated steps)
+#define AUDIO_MAX_LEAD (SAMPLE_RATE / 4)  // Leads outside [0, this] (pause, turbo, resets) rebase the timeline
+#define AUDIO_LEAD_SMOOTHING 0.02         // Per-block weight of the measured lead, averaging out step bursts
+#define AUDIO_RATE_GAIN 0.02              // Rate adjustment per AUDIO_LATENCY of lead error
+#define AUDIO_MAX_RATE_ADJUST 0.005       // Largest resampling deviation from 1:1 (inaudible pitch shift)
+#define AUDIO_CLOCK_SMOOTHING 0.05        // Per-poll weight of the measured device clock
+#define AUDIO_CLOCK_SNAP 50000000LL       // Device clock jumps larger than this (ns) are taken at once
+#define AUDIO_EVENT_CAPACITY 256          // Power of two
+#define AUDIO_POLL_MS 2
 
+typedef enum { SOUND_GATE, SOUND_PATTERN, SOUND_PITCH, SOUND_TONE, SOUND_SAMPLE, SOUND_SAMPLE_STOP } SoundEventKinds;
+
+// Sound change stamped with emulated time on the sample clock: the buzzer turning on or off, an
+// XO-CHIP pattern or pitch register write, a return to the plain square tone (reset), or a
+// MegaChip digitised sound starting or stopping
+typedef struct {
+  uint64_t sample;
+  uint8_t kind;
+  bool on;
+  uint8_t pitch;
+  uint8_t pattern[PATTERN_BYTES];
+  SampleData data;
+  unsigned rate;
+} SoundEvent;
+
+// Turns timestamped buzzer events into samples for an AudioBackend. The emulation thread only
+// pushes events into a single-producer/single-consumer ring.
+//
+// Realtime backends are fed from an audio thread that renders small blocks as the device frees
+// them. Emulated time is played back through a slightly variable rate (dynamic rate control)
+// that holds its lead over the playback position at AUDIO_LATENCY, so the stream never drifts
+// into an underrun or an ever-growing delay. The device's consumed-sample clock is published as
+// an offset from host time, which the main loop can use as the master clock for emulation.
+//
+// Offline backends are rendered on the emulation thread straight up to each emulated time
+// stamp, with no latency or rate control, so a WAV capture lines up with emulated cycles.
+//
+// Until an XO-CHIP ROM loads an audio pattern the buzzer plays the square tone; after that it
+// plays the pattern. Both sources run continuously and crossfade on a switch, so tone changes
+// never leave a gap. MegaChip digitised sounds play on top of either, outside the sound timer.
+//
+// The default constructor opens the OpenAL device on the audio thread itself, so start-up never
+// waits for it. Events queue in the ring meanwhile; if no device opens, the buzzer falls back
+// to discarding offline.
 class Buzzer {
   private:
-    ALuint source;
-    ALCdevice *device;
-    ALCcontext *context;
+    std::unique_ptr<AudioBackend> backend;
+
+    // Event ring (written by the emulation thread, read by whichever thread renders)
+    SoundEvent events[AUDIO_EVENT_CAPACITY];
+    std::atomic<unsigned> eventHead, eventTail;
+
+    // Rendering state
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> realtime;
+    double position;
+    double baseRatio;
+    double rateAdjust;
+    double lead;
+    bool synced;
+    bool on;
+    bool usePattern;
+    Synth synth;
+    PatternSynth patternSynth;
+    Sampler sampler;
+
+    // Tone settings (written by the UI, applied at block boundaries)
+    std::atomic<float> pitch, volume;
+
+    // Clocks: emulated time reached so far (sample clock), and host time minus device playback time
+    std::atomic<uint64_t> emulatedSample;
+    std::atomic<int64_t> clockOffset;
+    std::atomic<bool> clockValid;
+    std::atomic<float> rate;
+
+    // Deferred device start-up
+    std::atomic<bool> deviceReady;
+    std::atomic<float> openSeconds;
+
+    void Init(unsigned sampleRate, bool realtime);
+    void Push(const SoundEvent &event);
+    void Apply(const SoundEvent &event);
+    void AudioLoop();
+    void OpenDevice();
+    void Render(int16_t *block, int count);
+    void RenderUntil(uint64_t sample);
+    void UpdateRate();
+    void SampleClock(uint64_t now, uint64_t played);
 
   public:
     Buzzer();
+    Buzzer(std::unique_ptr<AudioBackend> backend);
     ~Buzzer();
-    void Play();
-    void Stop();
+    bool Realtime() { return realtime.load(std::memory_order_acquire); };
+    bool DeviceReady() { return deviceReady.load(std::memory_order_acquire); };
+    float OpenSeconds() { return openSeconds.load(std::memory_order_relaxed); };
+    void QueueEvent(uint64_t sample, bool on);
+    void QueuePattern(uint64_t sample, const uint8_t *pattern);
+    void QueuePitch(uint64_t sample, uint8_t pitch);
+    void QueueTone(uint64_t sample);
+    void QueueSample(uint64_t sample, SampleData data, unsigned rate, bool loop);
+    void QueueSampleStop(uint64_t sample);
+    void SetEmulatedTime(uint64_t sample);
+    void SetPitch(float hz) { pitch.store(hz, std::memory_order_relaxed); };
+    void SetVolume(float volume) { this->volume.store(volume, std::memory_order_relaxed); };
+    float Pitch() { return pitch.load(std::memory_order_relaxed); };
+    float Volume() { return volume.load(std::memory_order_relaxed); };
+    bool ClockValid() { return clockValid.load(std::memory_order_acquire); };
+    int64_t ClockOffset() { return clockOffset.load(std::memory_order_relaxed); };
+    float Rate() { return rate.load(std::memory_order_relaxed); };
 };
 
 #endif
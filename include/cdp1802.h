@@ -0,0 +1,71 @@
+#ifndef CDP1802_H
+#define CDP1802_H
+
+#include <cstdint>
+#include "paging.h"
+
+#define CDP1802_RETURN_REGISTER 4         // Routines hand control back with D4 (SEP R4)
+#define CDP1802_CALL_LIMIT 1000000        // Machine cycles before a routine that never returns is abandoned
+#define CDP1802_EF1_CYCLES 112            // EF1 (CDP1861 display status) is asserted for 8 lines before DMA
+
+// RCA CDP1802 CPU, as wired on the COSMAC VIP, for running machine-code subroutines out of the
+// shared memory map. Instructions decode through a table indexed by their high nibble (the
+// 1802's I field), with the low nibble (N) selecting a register or variant. Every instruction
+// costs 2 machine cycles of 8 clocks, long branches and skips 3, in the same units as the CHIP-8
+// interpreter's VIP timing.
+//
+// On the VIP the keypad latch is written with OUT 2 and read back on EF3, and Q drives the
+// speaker. EF1 follows the display's frame timing, phased from the cycle count the call
+// started at.
+class Cdp1802 {
+  private:
+    typedef void (Cdp1802::*Handler)();
+    static const Handler handlers[16];
+
+    PagedMemory *memory;
+    const unsigned char *keys;
+    unsigned frameCycles;
+
+    uint8_t P, X, D, T, N;
+    bool DF, IE, Q, idle, returned;
+    uint8_t keyLatch;
+    uint64_t cycles;
+    uint64_t clock;
+
+    uint8_t Read(uint16_t address) { return (*memory)[address]; };
+    void Write(uint16_t address, uint8_t value) { memory->Write(address, value); };
+    uint8_t Immediate() { return Read(R[P]++); };
+    bool Flag(int line);
+    bool Condition(int test);
+    void Add(uint8_t a, uint8_t b, bool carry);
+    void Subtract(uint8_t minuend, uint8_t subtrahend, bool carry);
+    void Step();
+    void opLoad();
+    void opIncrement();
+    void opDecrement();
+    void opShortBranch();
+    void opLoadAdvance();
+    void opStore();
+    void opInputOutput();
+    void opControl();
+    void opGetLow();
+    void opGetHigh();
+    void opPutLow();
+    void opPutHigh();
+    void opLongBranch();
+    void opSetP();
+    void opSetX();
+    void opArithmetic();
+
+  public:
+    uint16_t R[16];
+
+    Cdp1802(PagedMemory *memory, const unsigned char *keys, unsigned frameCycles);
+    void Reset();
+    void CloneFrom(const Cdp1802 &other);
+    uint64_t Call(uint16_t address, uint64_t clock);
+    bool Returned() { return returned; };
+    bool Speaker() { return Q; };
+};
+
+#endif
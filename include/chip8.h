@@ -4,73 +4,176 @@
 #include <iostream>
 #include <memory>
 #include <array>
+#include <sstream>
 #include "screen.h"
 #include "buzzer.h"
+#include "cdp1802.h"
+#include "core.h"
+#include "heatmap.h"
+#include "megachip.h"
+#include "metrics.h"
+#include "paging.h"
+#include "quirks.h"
+#include "scheduler.h"
 
-#define MEMORY 4096
-#define DISPLAY_FREQUENCY (float)1 / 120
+#define PROGRAM_START 0x200
+#define LORES_WIDTH 64
+#define LORES_HEIGHT 32
+#define BIG_FONT_ADDRESS 0x50             // SUPER-CHIP 8x10 digits follow the 4x5 font
+#define RPL_FLAGS 16
 #define LOG_WIDTH 50
+#define UNLIMITED_CYCLES 0
+#define UNLIMITED_BATCH 4096
+#define IDLE_LOOP_LENGTH 3                // Fx07; 3xkk/4xkk; 1nnn
+#define TURBO_KEY GLFW_KEY_TAB
+#define TURBO_MAX 0
+#define TURBO_DEFAULT_SPEED 4
+#define TURBO_PRESENT_INTERVAL (NANOSECONDS / 60)
 
-#define Byte unsigned char
-#define SignedByte char
-#define Word unsigned short
+// COSMAC VIP Timing (machine cycles of 8 clocks)
+#define VIP_CLOCK 1760900
+#define VIP_DMA_CYCLES 1024              // Stolen each frame by display DMA
+#define VIP_CYCLES_PER_FRAME (VIP_CLOCK / 8 / TIMER_FREQUENCY - VIP_DMA_CYCLES)
+#define VIP_SKIP_CYCLES 2
+#define VIP_REGISTER_CYCLES 14
+#define VIP_ROW_ALIGNED_CYCLES 15
+#define VIP_ROW_UNALIGNED_CYCLES 28
+
+// COSMAC VIP interpreter work areas, mirrored into memory around 0nnn machine-code calls
+#define VIP_STACK_POINTER 0x0ECF          // R2 (the 1802 stack, below the CHIP-8 stack)
+#define VIP_REGISTERS 0x0EF0              // V0-VF
+#define VIP_DISPLAY 0x0F00                // 64x32 display, 8 bytes per row
 
 typedef enum { DEBUG_FALSE, DEBUG_TRUE } DebugStates;
 
 class Chip8 {
   private:
-    // Memory & Registers
-    Byte memory[MEMORY];
-    Byte V[16];
-    Byte key[16];
-    Word I;
-    Word opcode;
-    void (Chip8::*opcodeTable[16])() = {
-      &Chip8::op0xxx,
-      &Chip8::op1xxx,
-      &Chip8::op2xxx,
-      &Chip8::op3xxx,
-      &Chip8::op4xxx,
-      &Chip8::op5xxx,
-      &Chip8::op6xxx,
-      &Chip8::op7xxx,
-      &Chip8::op8xxx,
-      &Chip8::op9xxx,
-      &Chip8::opAxxx,
-      &Chip8::opBxxx,
-      &Chip8::opCxxx,
-      &Chip8::opDxxx,
-      &Chip8::opExxx,
-      &Chip8::opFxxx,
-    };
+    // Machine state, owned here unless the caller supplies one
+    std::unique_ptr<CoreState> ownedState;
+    CoreState &state;
+
+    // Memory: pages of the fonts and loaded ROM, shared until written. 64 KB, or 16 MB for MegaChip.
+    PagedMemory memory;
+
+    // Dispatch by top nibble, one table per quirk profile
+    typedef void (Chip8::*OpcodeHandler)();
+    static const OpcodeHandler opcodeTables[QUIRK_PROFILES][16];
+    const OpcodeHandler *opcodeTable;
+    int quirkProfile;
 
     // Display
-    Byte display[DISPLAY_WIDTH * DISPLAY_HEIGHT];
     std::unique_ptr<Screen> screen;
 
+    // SUPER-CHIP
+    bool superChip;
+    Byte rplFlags[RPL_FLAGS];
+
+    // XO-CHIP (implies SUPER-CHIP)
+    bool xoChip;
+
+    // MegaChip (implies SUPER-CHIP; 0011 switches the 256x192 display in, 0010 back out)
+    bool megaChip;
+    bool megaMode;
+    int spriteWidth;
+    int spriteHeight;
+    std::vector<Byte> spriteBuffer;
+    MegaDisplay mega;
+
+    // RCA 1802 for 0nnn machine-code calls (CHIP-8 and VIP quirk profiles), which must land in
+    // the loaded program
+    std::unique_ptr<Cdp1802> cpu;
+    uint32_t programEnd;
+
     // Sound
     std::unique_ptr<Buzzer> buzzer;
+    bool soundOn;
+    Byte audioPattern[PATTERN_BYTES];
+    Byte audioPitch;
+    bool audioSync;
+    bool audioClocked;
+    bool headless;
 
     // State
-    Word pc;
-    Word stack[16];
-    Byte sp;
     Byte debugFlag;
-    Byte instructionFrequency;
+    uint64_t cyclesPerSecond;
     SignedByte keyPressed;
     bool paused;
+    bool waitingForKey;
+    bool waitingForVblank;
+    Byte waitRegister;
+
+    // Idle Loop Detection
+    bool idleSkip;
+    bool idling;
+    int idleLoopHead;
+    uint32_t idleLoopI;
+    Byte idleLoopSP;
+    Byte idleLoopV[16];
+
+    // Cycle Accounting
+    bool vipTiming;
+    uint64_t cycles;
+    uint64_t cycleTarget;
+    uint64_t cycleRemainder;
+    uint64_t stepCount;
+    uint64_t instructions;
+
+    // Position within the current step, for timestamping sound events
+    uint64_t stepSample;
+    uint64_t stepStart;
+    uint64_t stepBudget;
+
+    // Fast-Forward
+    bool turbo;
+    bool turboHeld;
+    bool turboActive;
+    bool turboMax;
+    int turboSpeed;
 
     // Timers
-    Byte delayTimer;
-    Byte soundTimer;
-    float lastTime, currentTime, elapsedTime, deltaTime;
+    Scheduler scheduler;
+
+    // Profiling, for windowed machines only (headless ones carry neither)
+    std::unique_ptr<Heatmap> heatmap;
+    std::unique_ptr<Metrics> metrics;
+
+    // Start-up Timings
+    uint64_t launchTime;
+    float startupTimes[STARTUP_PHASES];
+    bool frameReported;
+    bool audioReported;
+
+    // Logging
+    bool logging;
+    std::stringstream entry;
 
     // Functions
     void Reset();
+    void RunStep();
     void Tick();
+    uint64_t Run(uint64_t count);
     void EmulateCycle();
     void ProcessInput();
-    void UpdateTimers();
+    void Log();
+    void Heat(int kind, unsigned address) { if (heatmap) heatmap->Record(kind, address); };
+    bool InIdleLoop();
+    bool TickVIP();
+    uint64_t SoundClock();
+    void SetStartupTime(int phase, uint64_t nanoseconds);
+    void ReportStartup();
+    template <typename Quirks> int DrawSprite(DisplayRow *plane, int x, int y, uint32_t address, int height, int width);
+    void DrawMegaSprite(Byte x, Byte y);
+    void MachineCall(Word address);
+    void ExportVipDisplay();
+    void ImportVipDisplay();
+    void PlaySample();
+    bool MegaInstruction();
+    uint32_t AddressMask() { return megaChip ? MEGA_MEMORY - 1 : MEMORY - 1; };
+    void Scroll(int dx, int dy);
+    Word SkipSize();
+    template <typename Quirks> void AdvanceI(Byte x);
+    int Pixel(int x, int y);
+    void UpdateSound();
     void op0xxx();
     void op1xxx();
     void op2xxx();
@@ -79,23 +182,36 @@ class Chip8 {
     void op5xxx();
     void op6xxx();
     void op7xxx();
-    void op8xxx();
+    template <typename Quirks> void op8xxx();
     void op9xxx();
     void opAxxx();
-    void opBxxx();
+    template <typename Quirks> void opBxxx();
     void opCxxx();
-    void opDxxx();
+    template <typename Quirks> void opDxxx();
     void opExxx();
-    void opFxxx();
+    template <typename Quirks> void opFxxx();
 
     // Friends
     friend Screen;
 
   public:
-    Chip8(Byte instructionFrequency, Byte debugFlag);
+    Chip8(uint64_t cyclesPerSecond, Byte debugFlag, bool headless = false, CoreState *state = nullptr);
     ~Chip8();
     int LoadROM(const char *romPath);
+    void SetQuirkProfile(int profile);
+    int QuirkProfile() { return quirkProfile; };
+    void SetIdleSkip(bool enabled) { idleSkip = enabled; };
+    uint64_t Instructions() { return instructions; };
+    void SetMegaChip(bool enabled);
+    void CloneFrom(const Chip8 &other);
+    CoreState &State() { return state; };
+    const PagedMemory &Memory() { return memory; };
+    bool ServeMetrics(const char *socketPath);
+    void SetKey(Byte k, bool pressed);
+    void SetAudioBackend(std::unique_ptr<AudioBackend> backend);
     void StartMainLoop();
+    uint64_t RunHeadless(uint64_t frames);
+    void RunFrame();
 };
 
 #endif
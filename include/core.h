@@ -0,0 +1,52 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#define MEMORY 0x10000                     // XO-CHIP address space (F000 nnnn reaches all of it)
+                                           // MegaChip addresses up to MEGA_MEMORY
+#define DISPLAY_WIDTH 128                 // SUPER-CHIP hi-res; lo-res pixels are drawn 2x2
+#define DISPLAY_HEIGHT 64
+#define DISPLAY_PLANES 4                  // XO-CHIP bitplanes (Fn01); classic modes only use plane 0
+#define CACHE_LINE 64
+
+#define Byte unsigned char
+#define SignedByte char
+#define Word unsigned short
+
+// One display row as a bit mask, leftmost pixel in the most significant bit, so sprite rows and
+// horizontal scrolls are single shifts and XORs on the whole row
+typedef unsigned __int128 DisplayRow;
+static_assert(sizeof(DisplayRow) * 8 == DISPLAY_WIDTH, "DisplayRow must hold exactly one display row");
+
+// The emulated machine as plain data: the registers every instruction touches packed into the
+// first cache line, then the keypad and the bit-packed planes. Front-ends (Chip8, the debugger)
+// work on a CoreState by reference, so many machines can be packed densely in one array, and
+// saving or restoring a machine's registers and display is a single copy. Memory lives apart in
+// copy-on-write pages (paging.h), so machines running the same ROM share everything they have
+// not written.
+struct alignas(CACHE_LINE) CoreState {
+  // Hot registers
+  Byte V[16];
+  Word stack[16];
+  uint32_t I;
+  Word pc;
+  Word opcode;
+  Byte sp;
+  Byte delayTimer;
+  Byte soundTimer;
+  Byte planeMask;
+  bool hires;
+
+  // Keypad
+  alignas(CACHE_LINE) Byte key[16];
+
+  // Display (one bit-packed buffer per plane; a pixel's palette index has bit p set from plane p)
+  alignas(CACHE_LINE) DisplayRow planes[DISPLAY_PLANES][DISPLAY_HEIGHT];
+};
+static_assert(std::is_trivially_copyable_v<CoreState>, "CoreState must copy with memcpy");
+static_assert(offsetof(CoreState, hires) < CACHE_LINE, "Hot registers must fit in one cache line");
+
+#endif
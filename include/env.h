@@ -0,0 +1,89 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lanes.h"
+
+#define ENV_FRAME_SKIP 4                  // Frames each action is held for
+#define ENV_STICKY_ACTIONS 0.25f          // Chance per frame of repeating the previous action instead
+#define ENV_CYCLES_PER_SECOND 1920
+#define ENV_PROBE_FRAMES 60               // Frames a ROM must run on a lane before it is accepted
+
+// Per-environment hooks, called after every emulated frame with the lane core and lane holding
+// the environment. Rewards are summed over the frames of a step; an environment is done once the
+// done hook says so or its lane halts.
+typedef std::function<float(const LaneCore &core, int lane, unsigned env)> RewardHook;
+typedef std::function<bool(const LaneCore &core, int lane, unsigned env)> DoneHook;
+
+struct EnvOptions {
+  unsigned frameSkip = ENV_FRAME_SKIP;
+  float stickyActions = ENV_STICKY_ACTIONS;
+  uint64_t cyclesPerSecond = ENV_CYCLES_PER_SECOND;
+  unsigned threads = 0;                   // 0 uses every hardware thread
+  RewardHook reward;
+  DoneHook done;
+};
+
+// Batch stepping interface for training: N headless copies of one ROM, run LANES at a time on
+// lane cores spread across a pool of threads. An action is the set of keys held, one bit per key.
+//
+// Observations are written in place: each lane core draws straight into the observation buffer,
+// LANE_HEIGHT native-endian words per environment with column 0 in each row's top bit. The buffer
+// can be the caller's own (ObservationBytes(count) long, a whole number of LANES environments),
+// or a POSIX shared-memory object another process maps to read frames without any copies.
+class VectorEnv {
+  private:
+    unsigned count;
+    EnvOptions options;
+    std::unique_ptr<Chip8> machine;
+    std::vector<std::unique_ptr<LaneCore>> cores;
+    std::vector<uint16_t> held;
+    std::vector<uint32_t> random;
+
+    // Observations in shared memory, when shared
+    uint64_t *shared;
+    std::size_t sharedBytes;
+    std::string sharedName;
+
+    // Current step, read by the workers
+    const uint16_t *actions;
+    float *rewards;
+    bool *done;
+
+    // Worker pool (the calling thread steps the first share itself)
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    uint64_t generation;
+    unsigned pending;
+    bool stopping;
+
+    void WorkerLoop(unsigned worker);
+    void StepShare(unsigned worker);
+    void StepCore(unsigned group);
+    void Press(LaneCore &core, int lane, unsigned env, uint16_t keys);
+    void SetObservations(uint64_t *buffer);
+    void Unshare();
+
+  public:
+    VectorEnv(const char *romPath, unsigned count, EnvOptions options = EnvOptions(), uint64_t *observations = nullptr);
+    ~VectorEnv();
+    static std::size_t ObservationBytes(unsigned count);
+    // False if the ROM failed to load or its lanes halt within ENV_PROBE_FRAMES
+    bool Ready() { return !cores.empty(); };
+    unsigned Count() { return count; };
+    void Reset();
+    void Reset(unsigned env);
+    void Step(const uint16_t *actions, float *rewards, bool *done);
+    const uint64_t *Observation(unsigned env) { return cores[env / LANES]->Display(env % LANES); };
+    bool ShareObservations(const char *name);
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#define HEATMAP_SIZE 64
+#define HEATMAP_ADDRESSES (HEATMAP_SIZE * HEATMAP_SIZE)
+#define HEATMAP_DECAY 0.9f
+#define HEATMAP_KNEE 8.0f
+
+typedef enum { HEAT_EXECUTE, HEAT_READ, HEAT_WRITE, HEAT_KINDS } HeatKinds;
+
+class Heatmap {
+  private:
+    // One counter per address for each access kind, aligned for SIMD decay. Only the original
+    // 4 KB address space is tracked; accesses above it (XO-CHIP and MegaChip memory) show no heat.
+    alignas(16) float heat[HEAT_KINDS][HEATMAP_ADDRESSES];
+
+  public:
+    Heatmap();
+    void Clear();
+    void Decay();
+    void Record(int kind, unsigned address) { if (address < HEATMAP_ADDRESSES) heat[kind][address] += 1.0f; };
+    float Intensity(int kind, unsigned address) const;
+    void FillRGBA(unsigned char *rgba) const;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "core.h"
+#include "paging.h"
+#include "quirks.h"
+
+#define LANES 32                          // Instances per LaneCore, one bit each in a LaneMask
+#define ALL_LANES 0xFFFFFFFFu
+#define LANE_WIDTH 64                     // Lanes run lo-res programs only
+#define LANE_HEIGHT 32
+
+class Chip8;
+
+typedef uint32_t LaneMask;
+
+// CHIP-8 interpreter that runs LANES instances of one program in lockstep, for search and
+// reinforcement-learning workloads. Registers are stored structure-of-arrays (V[x] is LANES
+// consecutive bytes), so each step fetches an opcode for every lane, groups the lanes by opcode
+// and dispatches every group once with its lanes selected by a mask. Register arithmetic, skips,
+// pc updates and the timers work on 16 lanes per SSE2 operation; stack, memory and display
+// instructions loop over the selected lanes. Lanes running the same ROM mostly share an opcode,
+// so an instruction usually costs one dispatch instead of LANES.
+//
+// Lanes cover the original CHIP-8 instruction set in lo-res under any quirk profile, with the
+// scalar core's instructions-per-step timing, and each has its own copy-on-write memory. A lane
+// that reaches anything else (0nnn machine code, SUPER-CHIP or XO-CHIP instructions) halts and
+// shows up in Halted(), to be run on a Chip8 instead. Cxnn draws from a per-lane generator, so
+// lanes that roll dice drift apart from each other and from the scalar core.
+class LaneCore {
+  private:
+    typedef void (LaneCore::*Handler)(LaneMask lanes, Word opcode);
+    static const Handler handlerTables[QUIRK_PROFILES][16];
+    const Handler *handlers;
+    int quirkProfile;
+
+    // Registers, one lane per column
+    alignas(CACHE_LINE) Byte V[16][LANES];
+    alignas(CACHE_LINE) Byte delayTimer[LANES];
+    alignas(CACHE_LINE) Byte soundTimer[LANES];
+    alignas(CACHE_LINE) Word pc[LANES];
+    alignas(CACHE_LINE) Word I[LANES];
+    alignas(CACHE_LINE) Word opcodes[LANES];
+    alignas(CACHE_LINE) Word stack[16][LANES];
+    Byte sp[LANES];
+
+    // Per-lane machine. The display is LANE_HEIGHT rows per lane with column 0 in each row's top
+    // bit, owned here unless the caller supplies a buffer.
+    uint16_t keys[LANES];
+    Byte waitRegister[LANES];
+    uint32_t random[LANES];
+    std::unique_ptr<uint64_t[]> ownedDisplay;
+    uint64_t (*display)[LANE_HEIGHT];
+    std::vector<PagedMemory> memory;
+
+    // The machine every lane starts from, kept for Restart()
+    std::unique_ptr<CoreState> initial;
+    PagedMemory initialMemory;
+    bool runnable;
+
+    // Lanes that cannot run this step
+    LaneMask waitingForKey;
+    LaneMask waitingForVblank;
+    LaneMask halted;
+
+    // Timing
+    uint64_t cyclesPerSecond;
+    uint64_t cycleRemainder;
+    uint64_t stepCount;
+    uint64_t instructions;
+    uint64_t dispatches;
+
+    void RunStep();
+    void Execute(LaneMask lanes);
+    void Advance(LaneMask lanes, LaneMask skip);
+    void SetWords(Word *target, Word value, LaneMask lanes);
+    template <typename Quirks> bool DrawSprite(int lane, int x, int y, int height);
+    void op0xxx(LaneMask lanes, Word opcode);
+    void op1xxx(LaneMask lanes, Word opcode);
+    void op2xxx(LaneMask lanes, Word opcode);
+    void op3xxx(LaneMask lanes, Word opcode);
+    void op4xxx(LaneMask lanes, Word opcode);
+    void op5xxx(LaneMask lanes, Word opcode);
+    void op6xxx(LaneMask lanes, Word opcode);
+    void op7xxx(LaneMask lanes, Word opcode);
+    template <typename Quirks> void op8xxx(LaneMask lanes, Word opcode);
+    void op9xxx(LaneMask lanes, Word opcode);
+    void opAxxx(LaneMask lanes, Word opcode);
+    template <typename Quirks> void opBxxx(LaneMask lanes, Word opcode);
+    void opCxxx(LaneMask lanes, Word opcode);
+    template <typename Quirks> void opDxxx(LaneMask lanes, Word opcode);
+    void opExxx(LaneMask lanes, Word opcode);
+    template <typename Quirks> void opFxxx(LaneMask lanes, Word opcode);
+
+  public:
+    LaneCore(uint64_t cyclesPerSecond, uint64_t *display = nullptr);
+    void Load(Chip8 &machine);
+    void Restart(LaneMask lanes);
+    void Halt(LaneMask lanes) { halted |= lanes; };
+    void RunFrame();
+    void SetKey(int lane, Byte k, bool pressed);
+    void SetDisplay(uint64_t *rows);
+    void Export(int lane, CoreState &state) const;
+    LaneMask Halted() const { return halted; };
+    bool Runnable() const { return runnable; };
+    Byte Register(int lane, int r) const { return V[r][lane]; };
+    Word Pc(int lane) const { return pc[lane]; };
+    const uint64_t *Display(int lane) const { return display[lane]; };
+    uint64_t Instructions() const { return instructions; };
+    uint64_t Dispatches() const { return dispatches; };
+    const PagedMemory &Memory(int lane) const { return memory[lane]; };
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef MEGACHIP_H
+#define MEGACHIP_H
+
+#include <cstdint>
+#include <vector>
+
+#define MEGA_WIDTH 256
+#define MEGA_HEIGHT 192
+#define MEGA_PIXELS (MEGA_WIDTH * MEGA_HEIGHT)
+#define MEGA_PALETTE_SIZE 256
+#define MEGA_MEMORY 0x1000000              // 24-bit addresses, set by 01nn nnnn
+#define MEGA_SAMPLE_HEADER 6               // Rate (16 bits), length (24 bits), one reserved byte
+
+typedef enum { BLEND_NORMAL, BLEND_25, BLEND_50, BLEND_75, BLEND_ADD, BLEND_MULTIPLY, BLEND_MODES } BlendModes;
+
+// The MegaChip-8 256x192 display. Sprites are byte-per-pixel palette indices, with index 0
+// transparent. Each drawn pixel is resolved through the palette current at draw time and blended
+// into an RGBA back buffer, four pixels at a time when SSE2 is available. The index each pixel
+// was drawn with is kept alongside, since collisions are reported against one palette index.
+//
+// Drawing only touches the back buffer; 00E0 presents it and starts the next frame, so the
+// Screen only ever streams finished frames. The pixel buffers are only allocated while MegaChip
+// is enabled (see SetAllocated), so other machines don't carry them.
+class MegaDisplay {
+  private:
+    uint32_t palette[MEGA_PALETTE_SIZE];
+    std::vector<uint32_t> back, front;
+    std::vector<uint8_t> indices;
+    int blendMode;
+    uint8_t collisionIndex;
+    uint8_t alpha;
+
+  public:
+    MegaDisplay();
+    void SetAllocated(bool allocated);
+    void Reset();
+    void Clear();
+    void Present();
+    void Scroll(int dx, int dy);
+    void LoadPalette(const uint8_t *argb, int count);
+    bool DrawSprite(int x, int y, const uint8_t *sprite, int width, int height);
+    void SetBlendMode(int mode) { blendMode = mode < BLEND_MODES ? mode : BLEND_NORMAL; };
+    void SetCollisionIndex(uint8_t index) { collisionIndex = index; };
+    void SetAlpha(uint8_t alpha) { this->alpha = alpha; };
+    uint8_t Alpha() const { return alpha; };
+    int BlendMode() const { return blendMode; };
+    const uint32_t *Frame() const { return front.data(); };
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#define METRICS_FRAME_WINDOW 512
+#define METRICS_POLL_MS 250
+
+typedef enum { STARTUP_WINDOW, STARTUP_ROM, STARTUP_FIRST_FRAME, STARTUP_AUDIO, STARTUP_PHASES } StartupPhases;
+
+class Metrics {
+  private:
+    // Counters (written by the emulation loop, read by the server thread)
+    std::atomic<unsigned long long> instructions;
+    std::atomic<unsigned long long> skippedInstructions;
+    std::atomic<unsigned long long> frames;
+    std::atomic<unsigned long long> droppedFrames;
+    std::atomic<unsigned long long> hostFrames;
+    std::atomic<unsigned long long> soundMicroseconds;
+    std::atomic<unsigned> traceOccupancy, traceCapacity;
+    std::atomic<double> instructionsPerSecond;
+    std::atomic<double> frameTimeSum;
+    std::atomic<float> cpuUsage;
+    std::atomic<float> refreshRate, presentJitter;
+    std::atomic<float> startup[STARTUP_PHASES];
+
+    // Host frame times, a lock-free ring that the server samples for percentiles
+    std::atomic<float> frameTimes[METRICS_FRAME_WINDOW];
+    std::atomic<unsigned> frameTimeIndex;
+
+    // Effective IPS window
+    std::chrono::steady_clock::time_point windowStart;
+    unsigned long long windowInstructions;
+
+    // Server
+    std::thread server;
+    std::atomic<bool> serving;
+    std::string socketPath;
+
+    void ServeLoop(int listenFd);
+    std::string Render();
+
+  public:
+    Metrics();
+    ~Metrics();
+    bool Serve(const char *socketPath);
+    void Stop();
+    void AddInstructions(unsigned long long count);
+    void AddSkippedInstructions(unsigned long long count) { skippedInstructions.fetch_add(count, std::memory_order_relaxed); };
+    void AddFrame() { frames.fetch_add(1, std::memory_order_relaxed); };
+    void AddDroppedFrames(unsigned long long count) { droppedFrames.fetch_add(count, std::memory_order_relaxed); };
+    void AddHostFrame(float seconds);
+    void AddSoundTime(float seconds);
+    void SetTraceOccupancy(unsigned occupancy, unsigned capacity);
+    void SetCpuUsage(float usage) { cpuUsage.store(usage, std::memory_order_relaxed); };
+    void SetPresentation(float refreshRate, float jitter);
+    void SetStartupPhase(int phase, float seconds) { startup[phase].store(seconds, std::memory_order_relaxed); };
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <cstdint>
+
+#define PACER_DEFAULT_REFRESH 60          // Assumed refresh rate until the monitor reports one (Hz)
+#define PACER_SMOOTHING 0.05f             // Weight of each new swap interval in the refresh/jitter averages
+#define PACER_REFRESH_TOLERANCE 0.25f     // Intervals further than this fraction off the estimate are missed vblanks
+
+typedef enum { PRESENT_REPEAT, PRESENT_INTERPOLATE } PresentModes;
+
+// Presentation pacer. Measures the display refresh period from vsync-paced swaps (seeded from
+// the monitor's video mode) and, when the driver does not pace swaps itself, holds each present
+// back to the next refresh so frames reach a 120/144/240 Hz display at an even cadence.
+class FramePacer {
+  private:
+    uint64_t refreshPeriod;
+    uint64_t lastPresent;
+    float jitter;
+
+  public:
+    FramePacer();
+    void SetRefreshRate(int hz);
+    void RecordPresent(uint64_t now, bool vsync);
+    uint64_t NextPresent(uint64_t now);
+    void SleepUntilPresent();
+    float RefreshRate();
+    float Jitter() { return jitter; };
+};
+
+#endif
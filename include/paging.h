@@ -0,0 +1,47 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define PAGE_BITS 8
+#define PAGE_SIZE (1 << PAGE_BITS)
+#define PAGE_MASK (PAGE_SIZE - 1)
+
+typedef std::shared_ptr<const std::vector<uint8_t>> MemoryImage;
+
+// Page-granular copy-on-write memory over a shared, immutable image (fonts and ROM). Every page
+// reads straight from the image, or from a shared zero page past its end, until the first write
+// to it gives this memory a private copy. Instances running the same ROM therefore only pay for
+// the pages they have written, and copying a PagedMemory shares the image and duplicates just
+// those pages.
+class PagedMemory {
+  private:
+    MemoryImage image;
+    std::vector<const uint8_t *> pages;
+    std::vector<std::unique_ptr<uint8_t[]>> owned;
+    unsigned privatePages;
+
+    const uint8_t *SharedPage(uint32_t page) const;
+    uint8_t *Privatize(uint32_t page);
+
+  public:
+    PagedMemory(uint32_t size);
+    PagedMemory(const PagedMemory &other);
+    PagedMemory &operator=(const PagedMemory &other);
+    void Map(MemoryImage image);
+    void Resize(uint32_t size);
+    uint32_t Size() const { return pages.size() << PAGE_BITS; };
+    unsigned PrivatePages() const { return privatePages; };
+    uint8_t operator[](uint32_t address) const { return pages[address >> PAGE_BITS][address & PAGE_MASK]; };
+    void Write(uint32_t address, uint8_t value) {
+      uint32_t page = address >> PAGE_BITS;
+      uint8_t *target = owned[page] ? owned[page].get() : Privatize(page);
+      target[address & PAGE_MASK] = value;
+    };
+    void Read(uint32_t address, uint8_t *out, uint32_t count) const;
+    void Write(uint32_t address, const uint8_t *in, uint32_t count);
+};
+
+#endif
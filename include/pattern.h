@@ -0,0 +1,54 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <cstdint>
+
+#define PATTERN_BYTES 16
+#define PATTERN_BITS (PATTERN_BYTES * 8)
+#define PATTERN_BASE_RATE 4000.0          // Pattern bits per second at pitch 64
+#define PATTERN_DEFAULT_PITCH 64
+#define BLEP_TAPS 16                      // Step residual length in output samples (multiple of 4)
+#define BLEP_PHASES 64                    // Sub-sample step positions in the residual table
+#define BLEP_CUTOFF 0.45                  // Band limit as a fraction of the output sample rate
+
+// Plays an XO-CHIP 1-bit audio pattern on loop at the rate set by the pitch register,
+// 4000 * 2^((pitch - 64) / 48) bits per second, resampled to the output rate.
+//
+// The pattern is a train of steps, so it is resampled by placing each step at its exact
+// sub-sample time as a band-limited step (BLEP): the naive held level plus a precomputed residual
+// of a windowed-sinc step, mixed into a short accumulator four taps at a time. Output is delayed
+// by half the residual length so each step's ringing can start before it. New patterns and
+// pitches take over at the next bit boundary without restarting playback. Levels are centred on
+// the pattern's mean, so lopsided patterns carry no DC to thump on every fade (and an all-zero
+// pattern is silent).
+class PatternSynth {
+  private:
+    unsigned sampleRate;
+    uint8_t pattern[PATTERN_BYTES];
+    uint8_t pitch;
+    double rateScale;
+    double increment;
+    double position;
+    float level;
+    float mean;
+    float gain;
+    float volume;
+
+    alignas(16) float residuals[BLEP_PHASES][BLEP_TAPS];
+    float accumulator[BLEP_TAPS * 2];
+    int cursor;
+
+    void BuildResiduals();
+    void UpdateIncrement();
+    void AddStep(float delta, double offset);
+
+  public:
+    PatternSynth(unsigned sampleRate);
+    void SetPattern(const uint8_t *pattern);
+    void SetPitch(uint8_t pitch);
+    void SetRateScale(double scale);
+    void SetVolume(float volume);
+    float Next(bool on);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+typedef enum { QUIRKS_CHIP8, QUIRKS_VIP, QUIRKS_CHIP48, QUIRKS_SCHIP, QUIRKS_XOCHIP, QUIRK_PROFILES } QuirkProfiles;
+typedef enum { MEMORY_INCREMENT, MEMORY_INCREMENT_X, MEMORY_UNCHANGED } MemoryQuirks;
+
+// Behaviour that differs between CHIP-8 interpreters. Each profile is a compile-time policy: the
+// core's quirk-dependent opcode handlers are templates over it, so every check folds away.
+//
+//   shiftUsesVy     8xy6/8xyE shift V[y] into V[x] (otherwise V[x] in place)
+//   memory          Fx55/Fx65 leave I past the last register, at I + x, or unchanged
+//   jumpUsesVx      Bxnn jumps to xnn + V[x] (otherwise Bnnn jumps to nnn + V[0])
+//   logicResetsVF   8xy1/8xy2/8xy3 clear V[F]
+//   clipSprites     sprites are cut off at the display edges (otherwise they wrap around)
+//   displayWait     Dxyn waits for the next vertical blank
+//   collisionRows   hi-res Dxyn sets V[F] to the number of colliding (and clipped) rows
+//
+// The CHIP-8 profile is this emulator's long-standing default for .ch8 ROMs; the COSMAC VIP
+// profile is the original interpreter, whose display wait limits programs to one draw per frame.
+// The CHIP-8 profile keeps the old quirks but not the old flag bugs, which are fixed in every
+// profile: 8xy5/8xy7 set V[F] when nothing is borrowed (equal operands included), 8xy6/8xyE set
+// it to the bit shifted out, and 8xyN writes V[F] after the result.
+struct Chip8Quirks {
+  static constexpr bool shiftUsesVy = false;
+  static constexpr int memory = MEMORY_UNCHANGED;
+  static constexpr bool jumpUsesVx = false;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool clipSprites = true;
+  static constexpr bool displayWait = false;
+  static constexpr bool collisionRows = false;
+};
+
+struct VipQuirks {
+  static constexpr bool shiftUsesVy = true;
+  static constexpr int memory = MEMORY_INCREMENT;
+  static constexpr bool jumpUsesVx = false;
+  static constexpr bool logicResetsVF = true;
+  static constexpr bool clipSprites = true;
+  static constexpr bool displayWait = true;
+  static constexpr bool collisionRows = false;
+};
+
+struct Chip48Quirks {
+  static constexpr bool shiftUsesVy = false;
+  static constexpr int memory = MEMORY_INCREMENT_X;
+  static constexpr bool jumpUsesVx = true;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool clipSprites = true;
+  static constexpr bool displayWait = false;
+  static constexpr bool collisionRows = false;
+};
+
+struct SchipQuirks {
+  static constexpr bool shiftUsesVy = false;
+  static constexpr int memory = MEMORY_UNCHANGED;
+  static constexpr bool jumpUsesVx = true;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool clipSprites = true;
+  static constexpr bool displayWait = false;
+  static constexpr bool collisionRows = true;
+};
+
+struct XoChipQuirks {
+  static constexpr bool shiftUsesVy = true;
+  static constexpr int memory = MEMORY_INCREMENT;
+  static constexpr bool jumpUsesVx = false;
+  static constexpr bool logicResetsVF = false;
+  static constexpr bool clipSprites = false;
+  static constexpr bool displayWait = false;
+  static constexpr bool collisionRows = false;
+};
+
+#endif
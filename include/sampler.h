@@ -0,0 +1,38 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+typedef std::shared_ptr<const std::vector<uint8_t>> SampleData;
+
+// Plays a MegaChip digitised sound: unsigned 8-bit PCM at its own sample rate, linearly
+// interpolated to the output rate. A sample plays once or on loop until it is stopped or
+// replaced, independent of the sound timer. The data is shared with the event that started it,
+// so the emulated program can overwrite its memory without touching what is playing.
+class Sampler {
+  private:
+    unsigned sampleRate;
+    SampleData data;
+    bool loop;
+    double rate;
+    double rateScale;
+    double increment;
+    double position;
+    float gain;
+    float volume;
+    float last;
+
+    void UpdateIncrement();
+
+  public:
+    Sampler(unsigned sampleRate);
+    void Play(SampleData data, unsigned rate, bool loop);
+    void Stop();
+    void SetRateScale(double scale);
+    void SetVolume(float volume);
+    float Next();
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstdint>
+
+#define NANOSECONDS 1000000000ULL
+#define STEP_FREQUENCY 120                // Instruction batches per second
+#define TIMER_FREQUENCY 60                // Delay/sound timer rate (Hz)
+#define STEPS_PER_TIMER_TICK (STEP_FREQUENCY / TIMER_FREQUENCY)
+#define IDLE_WAIT 100000000ULL            // Event-wait timeout while paused (ns)
+#define SPIN_THRESHOLD 1500000ULL         // Final stretch before a deadline that is yielded instead of slept (ns)
+#define VSYNC_MIN_BLOCK 0.002f            // Average swap time above which vsync is considered active (s)
+#define MAX_CATCH_UP 8                    // Steps run back-to-back before the schedule skips ahead
+#define CPU_SAMPLE_PERIOD NANOSECONDS     // Host CPU usage sampling window (ns)
+
+// Fixed-timestep scheduler on a 64-bit nanosecond timebase. Step deadlines are computed from
+// the step index rather than accumulated, so instruction batches, timer ticks and wall time
+// stay in exact ratio no matter how long the emulator runs. Deadlines are measured on Clock(),
+// host time shifted by an offset, so another clock (the audio device's) can drive the grid.
+class Scheduler {
+  private:
+    // Emulation deadlines
+    uint64_t epoch;
+    uint64_t step;
+    uint64_t frequency;
+    int64_t clockOffset;
+
+    // Presentation
+    float swapTime;
+
+    // Host CPU usage
+    uint64_t sampleWallStart, sampleCpuStart;
+    float cpuUsage;
+
+    uint64_t Deadline(uint64_t step);
+    static uint64_t ProcessCpuTime();
+
+  public:
+    Scheduler();
+    static uint64_t Now();
+    uint64_t Clock() { return Now() - clockOffset; };
+    void SetClockOffset(int64_t offset) { clockOffset = offset; };
+    void Reset(uint64_t now, uint64_t frequency);
+    void Resync(uint64_t now);
+    int DueSteps(uint64_t now, uint64_t *dropped);
+    void CompleteStep() { step++; };
+    uint64_t NextStepDeadline() { return Deadline(step + 1); };
+    uint64_t TimeUntilStep(uint64_t now);
+    void SleepUntilStep();
+    void RecordSwap(float seconds);
+    bool VsyncActive() { return swapTime > VSYNC_MIN_BLOCK; };
+    void SampleCpuUsage(uint64_t now);
+    float CpuUsage() { return cpuUsage; };
+};
+
+#endif
@@ -9,11 +9,15 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include "shader.h"
+#include "core.h"
+#include "megachip.h"
+#include "pacer.h"
 
-#define DISPLAY_WIDTH 64
-#define DISPLAY_HEIGHT 32
+#define PLANE_BYTES (DISPLAY_PLANES * DISPLAY_HEIGHT * DISPLAY_WIDTH / 8)
+#define PALETTE_SIZE (1 << DISPLAY_PLANES)
 #define WIDTH 1920
 #define HEIGHT 960
+#define LOG_CAPACITY 100
 
 class Chip8;
 
@@ -24,22 +28,43 @@ class Screen {
     GLuint FBO;
     GLuint RBO;
     GLuint FBOtexture;
-    std::vector<unsigned char> *textureData;
+    GLuint heatmapTexture;
+    GLuint planeTexture;
+    GLuint megaTexture;
+    std::vector<unsigned char> heatmapData;
     std::unique_ptr<Shader> shader;
     Chip8 *chip8;
     std::vector<std::string> debugLog;
+    float swapTime;
+    bool vsync;
+
+    // Bit-packed planes of the latest and previous emulated frames, blended by how far
+    // presentation is between them
+    unsigned char frames[2][PLANE_BYTES];
+    uint64_t frameTime;
 
     void MenuBar();
     void Debugger();
     void UpdateTextureData();
+    void UpdateHeatmapTexture();
 
   public:
     GLFWwindow *window;
+    FramePacer pacer;
+    int presentMode;
+    float palette[PALETTE_SIZE][3];
 
     Screen(const char *vsPath, const char *fsPath, Chip8 *chip8);
     ~Screen();
     void Draw();
+    void PollEvents();
+    void WaitEvents(double timeout);
+    bool Focused();
+    void SetVsync(bool enabled);
+    float SwapTime() { return swapTime; };
+    void CaptureFrame(uint64_t now);
     void PushToLog(std::string entry);
+    int LogSize() { return debugLog.size(); };
 };
 
 #endif
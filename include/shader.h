@@ -20,6 +20,7 @@ class Shader {
     void setInt(const char *uniform, int value);
     void setFloat(const char *uniform, float value);
     void setVector3f(const char *uniform, glm::vec3 value);
+    void setVector3fArray(const char *uniform, const float *values, int count);
     void setMatrix4(const char *uniform, glm::mat4 value);
 };
 
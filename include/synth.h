@@ -0,0 +1,28 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#define SYNTH_FADE_SAMPLES 96             // Attack/release ramp length, ~2 ms at 44.1 kHz
+#define SYNTH_MIN_PITCH 50.0f
+#define SYNTH_MAX_PITCH 4000.0f
+
+// Band-limited square-wave oscillator. Edges are smoothed with PolyBLEP residuals so the tone
+// doesn't alias at any pitch, and gain ramps towards its target so onsets, releases and volume
+// changes never click. Generates one sample at a time for the streaming buffers.
+class Synth {
+  private:
+    unsigned sampleRate;
+    double phase;
+    double increment;
+    float gain;
+    float volume;
+
+    static float PolyBLEP(double t, double dt);
+
+  public:
+    Synth(unsigned sampleRate);
+    void SetPitch(float hz);
+    void SetVolume(float volume);
+    float Next(bool on);
+};
+
+#endif
@@ -1,10 +1,215 @@
 // External Libraries
 #include "chip8.h"
+#include "env.h"
+#include "lanes.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <utilities.h>
+#include <vector>
+#include <unistd.h>
+
+void usage(const char *program) {
+  std::cout << "Usage: " << program << " [options] [rom]\n"
+            << "  --cycles N          Instructions per second (default 1920)\n"
+            << "  --headless FRAMES   Run FRAMES emulated frames without a window, as fast as possible\n"
+            << "  --lanes FRAMES      Run " << LANES << " copies of the ROM on the lane core for FRAMES frames, each with its\n"
+            << "                      own scripted key presses, stopping at the first lane that differs from a\n"
+            << "                      scalar core given the same keys (ROMs using Cxnn will differ)\n"
+            << "  --envs COUNT        Step COUNT environments with random actions for the --headless frame\n"
+            << "                      count (default 600) and report the step rate\n"
+            << "  --share NAME        With --envs, keep observations in the POSIX shared-memory object NAME\n"
+            << "  --audio null        Discard audio\n"
+            << "  --audio wav:PATH[@RATE]\n"
+            << "                      Write the buzzer to a WAV file aligned to emulated time\n";
+}
+
+// Runs LANES copies of the ROM on the lane core next to one scalar Chip8 per lane, comparing every
+// lane's registers and display with its scalar twin after each frame, and reports the throughput
+// of both. Each lane and its twin get the same key presses from a script seeded by the lane
+// number, so lanes take different paths through the program (and the run is reproducible).
+int RunLanes(const char *romPath, uint64_t cyclesPerSecond, uint64_t frames) {
+  std::vector<std::unique_ptr<Chip8>> scalar;
+  auto lanes = std::make_unique<LaneCore>(cyclesPerSecond);
+  auto exported = std::make_unique<CoreState>();
+  uint64_t laneTime = 0, scalarTime = 0, scalarInstructions = 0, frame = 0;
+  uint32_t script[LANES];
+  uint16_t held[LANES] = {};
+  bool diverged = false;
+
+  if (cyclesPerSecond == UNLIMITED_CYCLES) {
+    std::cout << "Lane runs need a finite clock rate\n";
+    return EXIT_FAILURE;
+  }
+  for (int lane = 0; lane < LANES; lane++) {
+    scalar.push_back(std::make_unique<Chip8>(cyclesPerSecond, 0, true));
+    if (!scalar.back()->LoadROM(romPath)) {
+      std::cout << "Failed to load " << romPath << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  lanes->Load(*scalar[0]);
+  for (int lane = 0; lane < LANES; lane++) {
+    script[lane] = 0x9E3779B9u * (lane + 1);
+  }
+
+  for (; frame < frames && !diverged; frame++) {
+    // Key script: about every eighth frame a lane switches to holding one random key, or none
+    for (int lane = 0; lane < LANES; lane++) {
+      uint32_t &state = script[lane];
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      if (state % 8) continue;
+      uint16_t keys = (state >> 8) % 17 < 16 ? 1 << ((state >> 8) % 17) : 0;
+      for (int k = 0; k < 16; k++) {
+        if (!(((keys ^ held[lane]) >> k) & 1)) continue;
+        lanes->SetKey(lane, k, (keys >> k) & 1);
+        scalar[lane]->SetKey(k, (keys >> k) & 1);
+      }
+      held[lane] = keys;
+    }
+
+    uint64_t start = Scheduler::Now();
+    lanes->RunFrame();
+    laneTime += Scheduler::Now() - start;
+    for (int lane = 0; lane < LANES; lane++) {
+      start = Scheduler::Now();
+      scalar[lane]->RunFrame();
+      scalarTime += Scheduler::Now() - start;
+      if (diverged) continue;
+      CoreState &expected = scalar[lane]->State();
+      lanes->Export(lane, *exported);
+      bool same = std::equal(expected.V, expected.V + 16, exported->V) && expected.I == exported->I &&
+                  expected.pc == exported->pc && expected.sp == exported->sp &&
+                  std::equal(expected.stack, expected.stack + 16, exported->stack) &&
+                  expected.delayTimer == exported->delayTimer && expected.soundTimer == exported->soundTimer &&
+                  std::equal(expected.planes[0], expected.planes[0] + DISPLAY_HEIGHT, exported->planes[0]);
+      if (same) continue;
+      diverged = true;
+      std::cout << "Lane " << lane << " diverged at frame " << frame << ": pc " << Utilities::FormatHex(3, exported->pc)
+                << (lanes->Halted() & (LaneMask(1) << lane) ? " (halted on an instruction lanes cannot run)" : "")
+                << ", scalar pc " << Utilities::FormatHex(3, expected.pc) << "\n";
+    }
+  }
+  for (auto &machine : scalar) scalarInstructions += machine->Instructions();
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "Lanes:  " << lanes->Instructions() << " instructions in " << laneTime / 1e6 << " ms ("
+            << double(lanes->Instructions()) / std::max<uint64_t>(lanes->Dispatches(), 1) << " lanes per dispatch)\n"
+            << "Scalar: " << scalarInstructions << " instructions in " << scalarTime / 1e6 << " ms\n"
+            << (diverged ? "Stopped at the first mismatch after " : "All lanes matched the scalar core over ") << frame << " frames\n";
+  return diverged ? EXIT_FAILURE : 0;
+}
+
+// Steps `count` environments with random keys for `frames` frames and reports the step rate
+int RunEnvs(const char *romPath, uint64_t cyclesPerSecond, unsigned count, uint64_t frames, const char *share) {
+  EnvOptions options;
+  options.cyclesPerSecond = cyclesPerSecond;
+  VectorEnv envs(romPath, count, options);
+  if (!envs.Ready() || (share && !envs.ShareObservations(share))) return EXIT_FAILURE;
+
+  std::vector<uint16_t> actions(count);
+  std::vector<float> rewards(count);
+  auto done = std::make_unique<bool[]>(count);
+  uint64_t steps = std::max<uint64_t>(frames / options.frameSkip, 1), finished = 0;
+  uint32_t random = 1;
+  uint64_t start = Scheduler::Now();
+  for (uint64_t step = 0; step < steps; step++) {
+    for (auto &action : actions) {
+      random = random * 1664525 + 1013904223;
+      action = 1 << (random >> 28);
+    }
+    envs.Step(actions.data(), rewards.data(), done.get());
+    for (unsigned env = 0; env < count; env++) {
+      if (!done[env]) continue;
+      finished++;
+      envs.Reset(env);
+    }
+  }
+  double seconds = (Scheduler::Now() - start) / 1e9;
+
+  std::cout << std::fixed << std::setprecision(1)
+            << count << " environments, " << steps << " steps of " << options.frameSkip << " frames in "
+            << seconds * 1e3 << " ms: " << count * steps / seconds << " env steps/s, "
+            << count * steps * options.frameSkip / seconds << " frames/s, " << finished << " episodes ended\n";
+  return 0;
+}
 
 int main(int argc, char **argv) {
+  const char *romPath = "../roms/chip8Logo.ch8";
+  const char *audio = NULL;
+  uint64_t cyclesPerSecond = 1920;
+  uint64_t headlessFrames = 0;
+  uint64_t laneFrames = 0;
+  unsigned envCount = 0;
+  const char *share = NULL;
+  bool headless = false;
+
+  // Command Line
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--cycles") && i + 1 < argc) {
+      cyclesPerSecond = strtoull(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--headless") && i + 1 < argc) {
+      headless = true;
+      headlessFrames = strtoull(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--lanes") && i + 1 < argc) {
+      laneFrames = strtoull(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--envs") && i + 1 < argc) {
+      envCount = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--share") && i + 1 < argc) {
+      share = argv[++i];
+    } else if (!strcmp(argv[i], "--audio") && i + 1 < argc) {
+      audio = argv[++i];
+    } else if (argv[i][0] != '-') {
+      romPath = argv[i];
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (laneFrames) return RunLanes(romPath, cyclesPerSecond, laneFrames);
+  if (envCount) return RunEnvs(romPath, cyclesPerSecond, envCount, headless ? headlessFrames : 600, share);
+
   // Chip8
-  Chip8 chip8(16, 0);
-  chip8.LoadROM("../roms/chip8Logo.ch8");
+  Chip8 chip8(cyclesPerSecond, 0, headless);
+  if (!chip8.LoadROM(romPath)) {
+    std::cout << "Failed to load " << romPath << "\n";
+    return EXIT_FAILURE;
+  }
+
+  // Audio Output
+  if (audio && !strcmp(audio, "null")) {
+    chip8.SetAudioBackend(std::make_unique<NullBackend>());
+  } else if (audio && !strncmp(audio, "wav:", 4)) {
+    std::string path = audio + 4;
+    unsigned sampleRate = SAMPLE_RATE;
+    size_t at = path.rfind('@');
+    if (at != std::string::npos) {
+      sampleRate = strtoul(path.c_str() + at + 1, NULL, 10);
+      path.erase(at);
+    }
+    auto wav = std::make_unique<WavBackend>(path.c_str(), sampleRate ? sampleRate : SAMPLE_RATE);
+    if (!wav->Ready()) return EXIT_FAILURE;
+    chip8.SetAudioBackend(std::move(wav));
+  } else if (audio) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (headless) {
+    uint64_t frames = chip8.RunHeadless(headlessFrames);
+    std::cout << "Ran " << frames << " frames\n";
+    return 0;
+  }
+
+  // Metrics (one socket per process so multiple instances can be scraped)
+  std::string metricsSocket = "/tmp/chip8-" + std::to_string(getpid()) + ".sock";
+  chip8.ServeMetrics(metricsSocket.c_str());
+
   chip8.StartMainLoop();
 
   return 0;
@@ -0,0 +1,170 @@
+#include "audio.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool checkError();
+
+// Runs on the audio thread, so failures never exit: anything short of a working source closes
+// the device again and leaves Ready() false, and the buzzer carries on without sound
+OpenALBackend::OpenALBackend() {
+  int16_t silence[AUDIO_BLOCK] = {};
+  written = 0;
+  context = NULL;
+  device = alcOpenDevice(NULL);
+  if (!device) {
+    printf("Failed to open device\n");
+    return;
+  }
+  context = alcCreateContext(device, NULL);
+  if (!context || !alcMakeContextCurrent(context)) {
+    printf("Failed to create audio context\n");
+    Close();
+    return;
+  }
+  alGenBuffers(AUDIO_BUFFERS, buffers);
+  if (!checkError()) {
+    Close();
+    return;
+  }
+  alGenSources(1, &source);
+  if (!checkError()) {
+    alDeleteBuffers(AUDIO_BUFFERS, buffers);
+    Close();
+    return;
+  }
+  // Prime the queue with silence; each buffer is refilled as it is played
+  for (int i = 0; i < AUDIO_BUFFERS; i++) {
+    alBufferData(buffers[i], AL_FORMAT_MONO16, silence, sizeof(silence), SAMPLE_RATE);
+  }
+  alSourceQueueBuffers(source, AUDIO_BUFFERS, buffers);
+  if (!checkError()) {
+    alDeleteSources(1, &source);
+    alDeleteBuffers(AUDIO_BUFFERS, buffers);
+    Close();
+    return;
+  }
+  written = AUDIO_BUFFERS * AUDIO_BLOCK;
+  alSourcePlay(source);
+}
+
+// Prints and clears any pending OpenAL error. Returns false if there was one.
+static bool checkError() {
+  ALenum error;
+  if ((error = alGetError()) != AL_NO_ERROR) {
+    printf("OpenAL Error:\n");
+    switch (error) {
+      case ALC_INVALID_DEVICE:
+        printf("Invalid Device\n");
+        break;
+      case ALC_INVALID_CONTEXT:
+        printf("Invalid Context\n");
+        break;
+      case ALC_INVALID_ENUM:
+        printf("Invalid Enum\n");
+        break;
+      case ALC_INVALID_VALUE:
+        printf("Invalid Value\n");
+        break;
+      case ALC_OUT_OF_MEMORY:
+        printf("Out of Memory\n");
+        break;
+    }
+    return false;
+  }
+  return true;
+}
+
+// One block per buffer the source has finished with
+int OpenALBackend::Free() {
+  ALint processed = 0;
+  alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+  return processed * AUDIO_BLOCK;
+}
+
+// Refills the oldest played buffer, restarting the source after an underrun
+void OpenALBackend::Write(const int16_t *samples, int count) {
+  ALuint buffer;
+  ALint state;
+  alSourceUnqueueBuffers(source, 1, &buffer);
+  alBufferData(buffer, AL_FORMAT_MONO16, samples, count * sizeof(int16_t), SAMPLE_RATE);
+  alSourceQueueBuffers(source, 1, &buffer);
+  written += count;
+  alGetSourcei(source, AL_SOURCE_STATE, &state);
+  if (state != AL_PLAYING) alSourcePlay(source);
+}
+
+// Everything written, minus what is still queued, plus how far into the current buffer it is
+bool OpenALBackend::Played(uint64_t *samples) {
+  ALint state, queued = 0, offset = 0;
+  alGetSourcei(source, AL_SOURCE_STATE, &state);
+  if (state != AL_PLAYING) return false;
+  alGetSourcei(source, AL_BUFFERS_QUEUED, &queued);
+  alGetSourcei(source, AL_SAMPLE_OFFSET, &offset);
+  *samples = written - uint64_t(queued) * AUDIO_BLOCK + offset;
+  return true;
+}
+
+OpenALBackend::~OpenALBackend() {
+  if (!device) return;
+  alSourceStop(source);
+  alDeleteSources(1, &source);
+  alDeleteBuffers(AUDIO_BUFFERS, buffers);
+  Close();
+}
+
+// Releases the context (if one was made) and the device
+void OpenALBackend::Close() {
+  alcMakeContextCurrent(NULL);
+  if (context) alcDestroyContext(context);
+  alcCloseDevice(device);
+  context = NULL;
+  device = NULL;
+}
+
+WavBackend::WavBackend(const char *path, unsigned sampleRate) {
+  this->sampleRate = sampleRate;
+  dataBytes = 0;
+  file.open(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    printf("Failed to open %s\n", path);
+    return;
+  }
+  WriteHeader();
+}
+
+static void writeLE(std::ofstream &file, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    file.put(char((value >> (i * 8)) & 0xFF));
+  }
+}
+
+// Canonical 44-byte RIFF header for 16-bit mono PCM
+void WavBackend::WriteHeader() {
+  file.seekp(0);
+  file.write("RIFF", 4);
+  writeLE(file, 36 + dataBytes, 4);
+  file.write("WAVEfmt ", 8);
+  writeLE(file, 16, 4);
+  writeLE(file, 1, 2);
+  writeLE(file, 1, 2);
+  writeLE(file, sampleRate, 4);
+  writeLE(file, sampleRate * sizeof(int16_t), 4);
+  writeLE(file, sizeof(int16_t), 2);
+  writeLE(file, 16, 2);
+  file.write("data", 4);
+  writeLE(file, dataBytes, 4);
+}
+
+void WavBackend::Write(const int16_t *samples, int count) {
+  if (!file.is_open()) return;
+  for (int i = 0; i < count; i++) {
+    writeLE(file, uint16_t(samples[i]), 2);
+  }
+  dataBytes += count * sizeof(int16_t);
+}
+
+WavBackend::~WavBackend() {
+  if (!file.is_open()) return;
+  WriteHeader();
+  file.close();
+}
@@ -1,75 +1,227 @@
 #include "buzzer.h"
-#include <AL/al.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include "scheduler.h"
 
-void checkError();
+// Realtime OpenAL output, opened in the background
+Buzzer::Buzzer() : synth(SAMPLE_RATE), patternSynth(SAMPLE_RATE), sampler(SAMPLE_RATE) {
+  Init(SAMPLE_RATE, true);
+}
+
+Buzzer::Buzzer(std::unique_ptr<AudioBackend> backend) : synth(backend->SampleRate()), patternSynth(backend->SampleRate()),
+                                                         sampler(backend->SampleRate()) {
+  this->backend = std::move(backend);
+  Init(this->backend->SampleRate(), this->backend->Realtime());
+  deviceReady = realtime.load();
+}
+
+void Buzzer::Init(unsigned sampleRate, bool realtime) {
+  eventHead = 0;
+  eventTail = 0;
+  position = 0;
+  baseRatio = double(SAMPLE_RATE) / sampleRate;
+  rateAdjust = 1.0;
+  lead = AUDIO_LATENCY;
+  synced = false;
+  on = false;
+  usePattern = false;
+  pitch = FREQUENCY;
+  volume = VOLUME;
+  emulatedSample = 0;
+  clockOffset = 0;
+  clockValid = false;
+  rate = 1.0f;
+  deviceReady = false;
+  openSeconds = 0;
+
+  this->realtime = realtime;
+  running = realtime;
+  if (running) thread = std::thread(&Buzzer::AudioLoop, this);
+}
+
+// Runs on the audio thread. Without a device, the backend becomes a NullBackend that the
+// emulation thread drains offline; publishing `realtime` last hands it over safely.
+void Buzzer::OpenDevice() {
+  uint64_t start = Scheduler::Now();
+  auto device = std::make_unique<OpenALBackend>();
+  openSeconds.store(float(Scheduler::Now() - start) / NANOSECONDS, std::memory_order_relaxed);
+  if (device->Ready()) {
+    backend = std::move(device);
+    deviceReady.store(true, std::memory_order_release);
+    return;
+  }
+  backend = std::make_unique<NullBackend>();
+  running = false;
+  realtime.store(false, std::memory_order_release);
+}
+
+// Called from the emulation thread; never blocks and makes no device calls
+void Buzzer::Push(const SoundEvent &event) {
+  unsigned head = eventHead.load(std::memory_order_relaxed);
+  // A full ring means the renderer has stalled; dropping is better than blocking emulation
+  if (head - eventTail.load(std::memory_order_acquire) == AUDIO_EVENT_CAPACITY) return;
+  events[head % AUDIO_EVENT_CAPACITY] = event;
+  eventHead.store(head + 1, std::memory_order_release);
+}
+
+void Buzzer::QueueEvent(uint64_t sample, bool on) {
+  Push({ sample, SOUND_GATE, on });
+}
+
+void Buzzer::QueuePattern(uint64_t sample, const uint8_t *pattern) {
+  SoundEvent event = { sample, SOUND_PATTERN };
+  std::copy(pattern, pattern + PATTERN_BYTES, event.pattern);
+  Push(event);
+}
+
+void Buzzer::QueuePitch(uint64_t sample, uint8_t pitch) {
+  Push({ sample, SOUND_PITCH, false, pitch });
+}
 
-Buzzer::Buzzer() {
-  ALuint buffer;
-  ALuint samples[NUM_SAMPLES];
+void Buzzer::QueueTone(uint64_t sample) {
+  Push({ sample, SOUND_TONE });
+}
+
+// `loop` rides in the event's gate flag
+void Buzzer::QueueSample(uint64_t sample, SampleData data, unsigned rate, bool loop) {
+  SoundEvent event = { sample, SOUND_SAMPLE, loop };
+  event.data = std::move(data);
+  event.rate = rate;
+  Push(event);
+}
+
+void Buzzer::QueueSampleStop(uint64_t sample) {
+  Push({ sample, SOUND_SAMPLE_STOP });
+}
 
-  // Generate Tone
-  for (int i = 0; i < NUM_SAMPLES; i++) {
-    float t = (float)i / SAMPLE_RATE;
-    samples[i] = 16383 * ((sinf(2.0f * M_PI * FREQUENCY * t)) >= 0 ? 1.0f : -1.0f);
+// Runs on whichever thread renders, on the sample the event falls due
+void Buzzer::Apply(const SoundEvent &event) {
+  switch (event.kind) {
+    case SOUND_GATE:
+      on = event.on;
+      break;
+    case SOUND_PATTERN:
+      patternSynth.SetPattern(event.pattern);
+      usePattern = true;
+      break;
+    case SOUND_PITCH:
+      patternSynth.SetPitch(event.pitch);
+      break;
+    case SOUND_TONE:
+      patternSynth.SetPitch(PATTERN_DEFAULT_PITCH);
+      usePattern = false;
+      sampler.Stop();
+      break;
+    case SOUND_SAMPLE:
+      sampler.Play(event.data, event.rate, event.on);
+      break;
+    case SOUND_SAMPLE_STOP:
+      sampler.Stop();
+      break;
   }
+}
+
+// Called by the emulation thread at the end of every step
+void Buzzer::SetEmulatedTime(uint64_t sample) {
+  emulatedSample.store(sample, std::memory_order_relaxed);
+  if (!realtime.load(std::memory_order_acquire)) RenderUntil(sample);
+}
 
-  // OpenAL
-  device = alcOpenDevice(NULL);
-  if (!device) {
-    printf("Failed to open device\n");
-    exit(EXIT_FAILURE);
+// Keeps the realtime backend fed, one block per free buffer
+void Buzzer::AudioLoop() {
+  int16_t block[AUDIO_BLOCK];
+  if (!backend) OpenDevice();
+  while (running.load(std::memory_order_relaxed)) {
+    while (backend->Free() >= AUDIO_BLOCK) {
+      UpdateRate();
+      Render(block, AUDIO_BLOCK);
+      backend->Write(block, AUDIO_BLOCK);
+    }
+    uint64_t played;
+    if (backend->Played(&played)) SampleClock(Scheduler::Now(), played);
+    std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_POLL_MS));
   }
-  context = alcCreateContext(device, NULL);
-  alcMakeContextCurrent(context);
-  checkError();
-  alGenBuffers(1, &buffer);
-  checkError();
-  alBufferData(buffer, AL_FORMAT_MONO16, samples, NUM_SAMPLES * sizeof(int), SAMPLE_RATE);
-  alGenSources(1, &source);
-  checkError();
-  alSourcei(source, AL_BUFFER, buffer);
-  checkError();
-}
-
-void checkError() {
-  ALenum error;
-  if ((error = alGetError()) != AL_NO_ERROR) {
-    printf("OpenAL Error:\n");
-    switch (error) {
-      case ALC_INVALID_DEVICE:
-        printf("Invalid Device\n");
-        break;
-      case ALC_INVALID_CONTEXT:
-        printf("Invalid Context\n");
-        break;
-      case ALC_INVALID_ENUM:
-        printf("Invalid Enum\n");
-        break;
-      case ALC_INVALID_VALUE:
-        printf("Invalid Value\n");
-        break;
-      case ALC_OUT_OF_MEMORY:
-        printf("Out of Memory\n");
-        break;
+}
+
+// Offline backends: render everything up to emulated time `sample`
+void Buzzer::RenderUntil(uint64_t sample) {
+  int16_t block[AUDIO_BLOCK];
+  // A reset rewinds emulated time; restart the timeline there
+  if (sample < position) position = sample;
+  if (backend->Discards()) {
+    unsigned tail = eventTail.load(std::memory_order_relaxed);
+    while (tail != eventHead.load(std::memory_order_acquire) && events[tail % AUDIO_EVENT_CAPACITY].sample <= sample) {
+      Apply(events[tail % AUDIO_EVENT_CAPACITY]);
+      eventTail.store(++tail, std::memory_order_release);
     }
-    exit(EXIT_FAILURE);
+    position = sample;
+    return;
   }
+  int count;
+  while ((count = std::min<double>(AUDIO_BLOCK, (sample - position) / baseRatio)) > 0) {
+    Render(block, count);
+    backend->Write(block, count);
+  }
+}
+
+// Publishes the device playback position as a smoothed offset from host time
+void Buzzer::SampleClock(uint64_t now, uint64_t played) {
+  int64_t measured = int64_t(now) - int64_t(played * NANOSECONDS / backend->SampleRate());
+  int64_t current = clockOffset.load(std::memory_order_relaxed);
+  if (!clockValid.load(std::memory_order_relaxed) || std::llabs(measured - current) > AUDIO_CLOCK_SNAP)
+    current = measured;
+  else
+    current += int64_t((measured - current) * AUDIO_CLOCK_SMOOTHING);
+  clockOffset.store(current, std::memory_order_relaxed);
+  clockValid.store(true, std::memory_order_release);
 }
 
-void Buzzer::Play() {
-  alSourcePlay(source);
+// Dynamic rate control: nudges the playback rate so emulated time stays AUDIO_LATENCY samples
+// ahead of the playback position, whichever clock is driving emulation. Leads that are
+// negative or huge (paused, fast-forwarded, reset) rebase the timeline instead.
+void Buzzer::UpdateRate() {
+  double emulated = emulatedSample.load(std::memory_order_relaxed);
+  double measured = emulated - position;
+  if (!synced || measured < 0 || measured > AUDIO_MAX_LEAD) {
+    position = emulated - AUDIO_LATENCY;
+    lead = AUDIO_LATENCY;
+    synced = true;
+  } else {
+    lead += (measured - lead) * AUDIO_LEAD_SMOOTHING;
+  }
+  double error = (lead - AUDIO_LATENCY) / AUDIO_LATENCY;
+  rateAdjust = 1.0 + std::clamp(error * AUDIO_RATE_GAIN, -AUDIO_MAX_RATE_ADJUST, AUDIO_MAX_RATE_ADJUST);
+  rate.store(rateAdjust, std::memory_order_relaxed);
 }
 
-void Buzzer::Stop() {
-  alSourceStop(source);
-  alSourceRewind(source);
+// Renders the next `count` output samples, advancing the emulated playback position by the
+// current rate each sample and applying every queued event on the sample it falls due. The tone
+// is resampled along with the timeline, so its pitch follows the (sub-percent) rate change.
+void Buzzer::Render(int16_t *block, int count) {
+  double step = baseRatio * rateAdjust;
+  synth.SetPitch(pitch.load(std::memory_order_relaxed) * rateAdjust);
+  synth.SetVolume(volume.load(std::memory_order_relaxed));
+  patternSynth.SetRateScale(rateAdjust);
+  patternSynth.SetVolume(volume.load(std::memory_order_relaxed));
+  sampler.SetRateScale(rateAdjust);
+  sampler.SetVolume(volume.load(std::memory_order_relaxed));
+  for (int i = 0; i < count; i++) {
+    unsigned tail = eventTail.load(std::memory_order_relaxed);
+    while (tail != eventHead.load(std::memory_order_acquire)) {
+      const SoundEvent &event = events[tail % AUDIO_EVENT_CAPACITY];
+      if (event.sample > position) break;
+      Apply(event);
+      eventTail.store(++tail, std::memory_order_release);
+    }
+    // Pattern steps ring slightly past full scale at maximum volume
+    float value = synth.Next(on && !usePattern) + patternSynth.Next(on && usePattern) + sampler.Next();
+    block[i] = int16_t(std::clamp(value, -1.0f, 1.0f) * INT16_MAX);
+    position += step;
+  }
 }
 
 Buzzer::~Buzzer() {
-  alcMakeContextCurrent(NULL);
-  alcDestroyContext(context);
-  alcCloseDevice(device);
+  running = false;
+  if (thread.joinable()) thread.join();
 }
@@ -0,0 +1,280 @@
+#include "cdp1802.h"
+#include <algorithm>
+
+const Cdp1802::Handler Cdp1802::handlers[16] = {
+  &Cdp1802::opLoad,        &Cdp1802::opIncrement,  &Cdp1802::opDecrement,  &Cdp1802::opShortBranch,
+  &Cdp1802::opLoadAdvance, &Cdp1802::opStore,      &Cdp1802::opInputOutput, &Cdp1802::opControl,
+  &Cdp1802::opGetLow,      &Cdp1802::opGetHigh,    &Cdp1802::opPutLow,     &Cdp1802::opPutHigh,
+  &Cdp1802::opLongBranch,  &Cdp1802::opSetP,       &Cdp1802::opSetX,       &Cdp1802::opArithmetic,
+};
+
+Cdp1802::Cdp1802(PagedMemory *memory, const unsigned char *keys, unsigned frameCycles) {
+  this->memory = memory;
+  this->keys = keys;
+  this->frameCycles = frameCycles;
+  Reset();
+}
+
+void Cdp1802::Reset() {
+  std::fill(R, R + 16, 0);
+  P = X = D = T = N = 0;
+  DF = false;
+  IE = true;
+  Q = false;
+  idle = false;
+  returned = false;
+  keyLatch = 0;
+  cycles = 0;
+  clock = 0;
+}
+
+// Takes over `other`'s registers and flags, staying wired to this machine's memory and keypad
+void Cdp1802::CloneFrom(const Cdp1802 &other) {
+  std::copy(other.R, other.R + 16, R);
+  P = other.P;
+  X = other.X;
+  D = other.D;
+  T = other.T;
+  N = other.N;
+  DF = other.DF;
+  IE = other.IE;
+  Q = other.Q;
+  idle = other.idle;
+  returned = other.returned;
+  keyLatch = other.keyLatch;
+  cycles = other.cycles;
+  clock = other.clock;
+}
+
+// Runs the routine at `address` with P = 3 and X = 2 until it selects R4 as the program counter,
+// idles, or exceeds CDP1802_CALL_LIMIT. `clock` is the caller's cycle count, for EF1's timing.
+// Returns the machine cycles taken.
+uint64_t Cdp1802::Call(uint16_t address, uint64_t clock) {
+  this->clock = clock;
+  R[3] = address;
+  P = 3;
+  X = 2;
+  idle = false;
+  returned = false;
+  cycles = 0;
+  while (cycles < CDP1802_CALL_LIMIT && !idle) {
+    Step();
+    if (P == CDP1802_RETURN_REGISTER) {
+      returned = true;
+      break;
+    }
+  }
+  return cycles;
+}
+
+void Cdp1802::Step() {
+  uint8_t instruction = Immediate();
+  N = instruction & 0x0F;
+  cycles += 2;
+  (this->*handlers[instruction >> 4])();
+}
+
+// External flags: EF1 is the display's vertical status, EF3 the latched keypad key
+bool Cdp1802::Flag(int line) {
+  switch (line) {
+    case 1: return frameCycles && (clock + cycles) % frameCycles >= frameCycles - CDP1802_EF1_CYCLES;
+    case 3: return keys[keyLatch];
+    default: return false;
+  }
+}
+
+// Branch conditions 0-7 of the low three bits of a short branch: always, Q, D = 0, DF, EF1-EF4
+bool Cdp1802::Condition(int test) {
+  switch (test) {
+    case 0: return true;
+    case 1: return Q;
+    case 2: return D == 0;
+    case 3: return DF;
+    default: return Flag(test - 3);
+  }
+}
+
+void Cdp1802::Add(uint8_t a, uint8_t b, bool carry) {
+  unsigned sum = a + b + carry;
+  D = sum;
+  DF = sum > 0xFF;
+}
+
+// DF is the 1802's inverted borrow: set when no borrow occurred, and a borrow-in when clear
+void Cdp1802::Subtract(uint8_t minuend, uint8_t subtrahend, bool carry) {
+  Add(minuend, ~subtrahend, carry);
+}
+
+// 0x00 - IDL (wait for an interrupt or DMA, which ends the call); 0x0N - LDN: D = M(R[N])
+void Cdp1802::opLoad() {
+  if (N == 0)
+    idle = true;
+  else
+    D = Read(R[N]);
+}
+
+// 0x1N - INC R[N]
+void Cdp1802::opIncrement() {
+  R[N]++;
+}
+
+// 0x2N - DEC R[N]
+void Cdp1802::opDecrement() {
+  R[N]--;
+}
+
+// 0x3N - Short branch within the page when the condition holds (N >= 8 negates it, so 0x38 skips)
+void Cdp1802::opShortBranch() {
+  if (Condition(N & 7) != bool(N & 8))
+    R[P] = (R[P] & 0xFF00) | Read(R[P]);
+  else
+    R[P]++;
+}
+
+// 0x4N - LDA: D = M(R[N]), R[N]++
+void Cdp1802::opLoadAdvance() {
+  D = Read(R[N]++);
+}
+
+// 0x5N - STR: M(R[N]) = D
+void Cdp1802::opStore() {
+  Write(R[N], D);
+}
+
+// 0x60 - IRX; 0x61-0x67 - OUT: port N = M(R[X]), R[X]++; 0x69-0x6F - INP: M(R[X]) = D = port N - 8.
+// Only the VIP's keypad latch (port 2) is wired; other ports read as 0.
+void Cdp1802::opInputOutput() {
+  if (N == 0) {
+    R[X]++;
+  } else if (N < 8) {
+    if (N == 2) keyLatch = Read(R[X]) & 0x0F;
+    R[X]++;
+  } else if (N > 8) {
+    D = 0;
+    Write(R[X], D);
+  }
+}
+
+void Cdp1802::opControl() {
+  switch (N) {
+    // 0x70 / 0x71 - RET / DIS: X, P = M(R[X]), R[X]++, enabling / disabling interrupts
+    case 0x0: case 0x1: {
+      uint8_t value = Read(R[X]++);
+      X = value >> 4;
+      P = value & 0x0F;
+      IE = N == 0x0;
+      break;
+    }
+    // 0x72 - LDXA: D = M(R[X]), R[X]++
+    case 0x2: D = Read(R[X]++); break;
+    // 0x73 - STXD: M(R[X]) = D, R[X]--
+    case 0x3: Write(R[X]--, D); break;
+    // 0x74 / 0x75 / 0x77 - ADC / SDB / SMB with M(R[X])
+    case 0x4: Add(Read(R[X]), D, DF); break;
+    case 0x5: Subtract(Read(R[X]), D, DF); break;
+    case 0x7: Subtract(D, Read(R[X]), DF); break;
+    // 0x76 - SHRC: rotate D right through DF
+    case 0x6: {
+      bool carry = DF;
+      DF = D & 1;
+      D = (D >> 1) | (carry << 7);
+      break;
+    }
+    // 0x78 - SAV: M(R[X]) = T
+    case 0x8: Write(R[X], T); break;
+    // 0x79 - MARK: T = X, P; M(R[2]) = T; X = P; R[2]--
+    case 0x9:
+      T = (X << 4) | P;
+      Write(R[2], T);
+      X = P;
+      R[2]--;
+      break;
+    // 0x7A / 0x7B - REQ / SEQ
+    case 0xA: Q = false; break;
+    case 0xB: Q = true; break;
+    // 0x7C / 0x7D / 0x7F - ADCI / SDBI / SMBI with the immediate byte
+    case 0xC: Add(Immediate(), D, DF); break;
+    case 0xD: Subtract(Immediate(), D, DF); break;
+    case 0xF: Subtract(D, Immediate(), DF); break;
+    // 0x7E - SHLC: rotate D left through DF
+    case 0xE: {
+      bool carry = DF;
+      DF = D >> 7;
+      D = (D << 1) | carry;
+      break;
+    }
+  }
+}
+
+// 0x8N - GLO: D = R[N].0
+void Cdp1802::opGetLow() {
+  D = R[N] & 0xFF;
+}
+
+// 0x9N - GHI: D = R[N].1
+void Cdp1802::opGetHigh() {
+  D = R[N] >> 8;
+}
+
+// 0xAN - PLO: R[N].0 = D
+void Cdp1802::opPutLow() {
+  R[N] = (R[N] & 0xFF00) | D;
+}
+
+// 0xBN - PHI: R[N].1 = D
+void Cdp1802::opPutHigh() {
+  R[N] = (R[N] & 0x00FF) | (D << 8);
+}
+
+// 0xCN - Long branches (N & 4 clear) jump to the next two bytes when the condition holds, long
+// skips (N & 4 set) step over them. Either way the instruction takes a third machine cycle.
+void Cdp1802::opLongBranch() {
+  cycles++;
+  int test = N & 3;
+  bool negate = N & 8;
+  if (!(N & 4)) {
+    if (Condition(test) != negate)
+      R[P] = (Read(R[P]) << 8) | Read(R[P] + 1);
+    else
+      R[P] += 2;
+    return;
+  }
+  // 0xC4 is NOP and 0xCC is LSIE; the rest skip on Q, D = 0 or DF (negated below 0xC8)
+  bool skip = test == 0 ? negate && IE : Condition(test) == negate;
+  if (skip) R[P] += 2;
+}
+
+// 0xDN - SEP: P = N
+void Cdp1802::opSetP() {
+  P = N;
+}
+
+// 0xEN - SEX: X = N
+void Cdp1802::opSetX() {
+  X = N;
+}
+
+// 0xF0-0xF7 operate on M(R[X]), 0xF8-0xFF on the immediate byte: LDX/LDI, OR/ORI, AND/ANI,
+// XOR/XRI, ADD/ADI, SD/SDI, SHR/SHL, SM/SMI
+void Cdp1802::opArithmetic() {
+  if (N == 0x6) {
+    DF = D & 1;
+    D >>= 1;
+    return;
+  }
+  if (N == 0xE) {
+    DF = D >> 7;
+    D <<= 1;
+    return;
+  }
+  uint8_t operand = N & 8 ? Immediate() : Read(R[X]);
+  switch (N & 7) {
+    case 0: D = operand; break;
+    case 1: D |= operand; break;
+    case 2: D &= operand; break;
+    case 3: D ^= operand; break;
+    case 4: Add(operand, D, false); break;
+    case 5: Subtract(operand, D, true); break;
+    case 7: Subtract(D, operand, true); break;
+  }
+}
@@ -2,11 +2,15 @@
 #include "screen.h"
 #include <GLFW/glfw3.h>
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <time.h>
@@ -50,39 +54,233 @@ Byte fontset[80] = {
   0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-Chip8::Chip8(Byte instructionFrequency, Byte debugFlag) {
-  this->instructionFrequency = instructionFrequency;
+// SUPER-CHIP 8x10 digits (0-9 as on the HP48; A-F as popularised by Octo)
+Byte bigFontset[160] = {
+  0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+  0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+  0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+  0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+  0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+  0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+  0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+  0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+  0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+  0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+  0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+  0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+  0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// ROM images by path, shared by every instance that loads the same, unchanged file
+typedef struct {
+  std::weak_ptr<const std::vector<uint8_t>> image;
+  std::filesystem::file_time_type modified;
+  std::size_t size;
+} CachedImage;
+static std::map<std::string, CachedImage> imageCache;
+static std::mutex imageCacheMutex;
+
+// Fonts at 0 followed by `size` bytes of ROM at PROGRAM_START, padded to whole pages
+static MemoryImage BuildImage(std::istream *rom, std::size_t size) {
+  auto image = std::make_shared<std::vector<uint8_t>>((PROGRAM_START + size + PAGE_MASK) & ~std::size_t(PAGE_MASK), 0);
+  std::copy(fontset, fontset + 80, image->begin());
+  std::copy(bigFontset, bigFontset + 160, image->begin() + BIG_FONT_ADDRESS);
+  if (rom) rom->read(reinterpret_cast<char*>(image->data() + PROGRAM_START), size);
+  return image;
+}
+
+// Returns the image for a ROM, reading the file only when no live instance holds its current contents
+static MemoryImage SharedImage(const char *romPath, std::istream &rom, std::size_t size) {
+  std::error_code error;
+  std::string key = std::filesystem::weakly_canonical(romPath, error).string();
+  if (error) key = romPath;
+  auto modified = std::filesystem::last_write_time(romPath, error);
+  std::lock_guard<std::mutex> lock(imageCacheMutex);
+  CachedImage &cached = imageCache[key];
+  MemoryImage image = cached.image.lock();
+  if (image && cached.modified == modified && cached.size == size) return image;
+  image = BuildImage(&rom, size);
+  cached = { image, modified, size };
+  return image;
+}
+
+// Doubles every bit of a byte (abcdefgh -> aabbccddeeffgghh), widening lo-res sprite rows
+constexpr std::array<uint16_t, 256> spreadTable = [] {
+  std::array<uint16_t, 256> table{};
+  for (int byte = 0; byte < 256; byte++) {
+    for (int bit = 0; bit < 8; bit++) {
+      if (byte & (1 << bit)) table[byte] |= 3 << (bit * 2);
+    }
+  }
+  return table;
+}();
+
+// Handlers that depend on quirks are instantiated once per profile, so switching profiles swaps
+// tables instead of testing quirks on every instruction
+#define OPCODE_TABLE(Quirks) {                                                       \
+  &Chip8::op0xxx, &Chip8::op1xxx, &Chip8::op2xxx, &Chip8::op3xxx,                     \
+  &Chip8::op4xxx, &Chip8::op5xxx, &Chip8::op6xxx, &Chip8::op7xxx,                     \
+  &Chip8::op8xxx<Quirks>, &Chip8::op9xxx, &Chip8::opAxxx, &Chip8::opBxxx<Quirks>,     \
+  &Chip8::opCxxx, &Chip8::opDxxx<Quirks>, &Chip8::opExxx, &Chip8::opFxxx<Quirks>,     \
+}
+
+const Chip8::OpcodeHandler Chip8::opcodeTables[QUIRK_PROFILES][16] = {
+  OPCODE_TABLE(Chip8Quirks),
+  OPCODE_TABLE(VipQuirks),
+  OPCODE_TABLE(Chip48Quirks),
+  OPCODE_TABLE(SchipQuirks),
+  OPCODE_TABLE(XoChipQuirks),
+};
+
+// Approximate COSMAC VIP interpreter cost of each instruction in machine cycles, indexed by the
+// opcode's high nibble and low byte. Costs that depend on operands (taken skips, Dxyn rows,
+// Fx55/Fx65 register counts) are added by the instruction handlers.
+constexpr std::array<Byte, 4096> vipCycleTable = [] {
+  std::array<Byte, 4096> table{};
+  for (int key = 0; key < 4096; key++) {
+    Byte low = key & 0xFF;
+    switch (key >> 8) {
+      case 0x0: table[key] = low == 0xE0 ? 24 : 23; break;
+      case 0x1: case 0x2: case 0xB: table[key] = 23; break;
+      case 0x3: case 0x4: case 0x7: table[key] = 10; break;
+      case 0x5: case 0x9: case 0xE: table[key] = 14; break;
+      case 0x6: table[key] = 6; break;
+      case 0x8: table[key] = 44; break;
+      case 0xA: table[key] = 12; break;
+      case 0xC: table[key] = 36; break;
+      case 0xD: table[key] = 26; break;
+      case 0xF:
+        switch (low) {
+          case 0x1E: table[key] = 19; break;
+          case 0x29: table[key] = 20; break;
+          case 0x33: table[key] = 204; break;
+          case 0x55: case 0x65: table[key] = 14; break;
+          default: table[key] = 10; break;
+        }
+        break;
+    }
+  }
+  return table;
+}();
+
+Chip8::Chip8(uint64_t cyclesPerSecond, Byte debugFlag, bool headless, CoreState *state)
+  : ownedState(state ? nullptr : std::make_unique<CoreState>()), state(state ? *state : *ownedState), memory(MEMORY) {
+  launchTime = Scheduler::Now();
+  cpu = std::make_unique<Cdp1802>(&memory, this->state.key, VIP_CYCLES_PER_FRAME);
+  std::fill(startupTimes, startupTimes + STARTUP_PHASES, 0.0f);
+  frameReported = false;
+  audioReported = false;
+  this->cyclesPerSecond = cyclesPerSecond;
+  this->headless = headless;
+  logging = !headless;
   this->debugFlag = debugFlag;
+  idleSkip = true;
+  vipTiming = false;
+  turbo = false;
+  turboHeld = false;
+  turboActive = false;
+  turboMax = false;
+  turboSpeed = TURBO_DEFAULT_SPEED;
+  soundOn = false;
+  superChip = false;
+  xoChip = false;
+  megaChip = false;
+  SetQuirkProfile(QUIRKS_CHIP8);
+  std::fill(rplFlags, rplFlags + RPL_FLAGS, 0);
+  audioSync = false;
+  audioClocked = false;
   Reset();
+  if (headless) {
+    buzzer = std::make_unique<Buzzer>(std::make_unique<NullBackend>());
+    return;
+  }
+  heatmap = std::make_unique<Heatmap>();
+  metrics = std::make_unique<Metrics>();
   screen = std::make_unique<Screen>("../vertexShader.glsl", "../fragmentShader.glsl", this);
+  SetStartupTime(STARTUP_WINDOW, Scheduler::Now() - launchTime);
+  // The audio device opens on the buzzer's own thread, so the first frame never waits for it
+  // (and without one, the buzzer carries on silently instead of exiting)
   buzzer = std::make_unique<Buzzer>();
 }
 
+void Chip8::SetStartupTime(int phase, uint64_t nanoseconds) {
+  startupTimes[phase] = float(nanoseconds) / NANOSECONDS;
+  if (metrics) metrics->SetStartupPhase(phase, startupTimes[phase]);
+}
+
+// Prints each start-up milestone once, as it is reached
+void Chip8::ReportStartup() {
+  if (!frameReported) {
+    SetStartupTime(STARTUP_FIRST_FRAME, Scheduler::Now() - launchTime);
+    std::cout << std::fixed << std::setprecision(1) << "Start-up: window " << startupTimes[STARTUP_WINDOW] * 1000.0f
+              << " ms, ROM " << startupTimes[STARTUP_ROM] * 1000.0f
+              << " ms, first frame at " << startupTimes[STARTUP_FIRST_FRAME] * 1000.0f << " ms\n";
+    frameReported = true;
+  }
+  if (!audioReported && buzzer->DeviceReady()) {
+    SetStartupTime(STARTUP_AUDIO, Scheduler::Now() - launchTime);
+    std::cout << std::fixed << std::setprecision(1) << "Start-up: audio ready by " << startupTimes[STARTUP_AUDIO] * 1000.0f
+              << " ms (device opened in " << buzzer->OpenSeconds() * 1000.0f << " ms off the main thread)\n";
+    audioReported = true;
+  } else if (!audioReported && !buzzer->Realtime()) {
+    std::cout << "Start-up: no audio device in use\n";
+    audioReported = true;
+  }
+}
+
+// Replaces the audio output, e.g. with a WavBackend for batch runs
+void Chip8::SetAudioBackend(std::unique_ptr<AudioBackend> backend) {
+  buzzer = std::make_unique<Buzzer>(std::move(backend));
+  soundOn = false;
+}
+
 void Chip8::Reset() {
-  I  = 0;
-  pc = 0x200;
-  sp = 0;
-  delayTimer = 0;
-  soundTimer = 0;
-  lastTime = 0;
-  currentTime = 0;
-  elapsedTime = 0;
-  deltaTime = 0;
-  opcode = 0;
+  state.I  = 0;
+  state.pc = PROGRAM_START;
+  state.sp = 0;
+  state.delayTimer = 0;
+  state.soundTimer = 0;
+  state.opcode = 0;
   paused = false;
+  waitingForKey = false;
+  waitingForVblank = false;
+  waitRegister = 0;
+  idleLoopHead = -1;
+  cycles = 0;
+  cycleTarget = 0;
+  cycleRemainder = 0;
+  stepCount = 0;
+  instructions = 0;
+  stepSample = 0;
+  stepStart = 0;
+  stepBudget = 0;
+  if (heatmap) heatmap->Clear();
 
   srand(time(NULL));
-  std::fill(memory, memory + MEMORY, 0);
-  std::fill(stack, stack + 16, 0);
-  for (int i = 0; i < 80; i++) {
-    memory[i] = fontset[i];
-  }
-  std::fill(display, display + (DISPLAY_WIDTH * DISPLAY_HEIGHT), 0);
+  static const MemoryImage fonts = BuildImage(nullptr, 0);
+  memory.Map(fonts);
+  programEnd = PROGRAM_START;
+  std::fill(state.stack, state.stack + 16, 0);
+  std::fill(state.key, state.key + 16, 0);
+  keyPressed = -1;
+  std::fill(&state.planes[0][0], &state.planes[0][0] + DISPLAY_PLANES * DISPLAY_HEIGHT, 0);
+  state.planeMask = 1;
+  state.hires = false;
+  megaMode = false;
+  spriteWidth = 0;
+  spriteHeight = 0;
+  mega.Reset();
+  cpu->Reset();
+  std::fill(audioPattern, audioPattern + PATTERN_BYTES, 0);
+  audioPitch = PATTERN_DEFAULT_PITCH;
+  if (buzzer) buzzer->QueueTone(stepSample);
 }
 
 int Chip8::LoadROM(const char *romPath) {
-  Byte *buffer;
-  std::size_t bufferSize;
+  uint64_t start = Scheduler::Now();
   std::ifstream rom(romPath, std::ios::binary | std::ios::ate);
 
   Reset();
@@ -90,466 +288,1188 @@ int Chip8::LoadROM(const char *romPath) {
   if (!rom.is_open())
     return 0;
 
-  bufferSize = rom.tellg();
-  buffer = new Byte[bufferSize];
+  // SUPER-CHIP, XO-CHIP and MegaChip ROMs are conventionally distributed as .sc8, .xo8 and .mc8.
+  // Every load sets all three modes, so a previous ROM's mode doesn't carry over.
+  std::filesystem::path extension = std::filesystem::path(romPath).extension();
+  superChip = extension == ".sc8" || extension == ".xo8" || extension == ".mc8";
+  xoChip = extension == ".xo8";
+  SetMegaChip(extension == ".mc8");
+  SetQuirkProfile(xoChip ? QUIRKS_XOCHIP : superChip ? QUIRKS_SCHIP : QUIRKS_CHIP8);
 
+  // MegaChip programs carry their sprites and samples past 64 KB; other modes only map the first 64 KB
+  std::size_t romSize = std::min<std::size_t>(rom.tellg(), MEGA_MEMORY - PROGRAM_START);
   rom.seekg(0, rom.beg);
-  rom.read(reinterpret_cast<char*>(buffer), bufferSize);
-
-  for (int i = 0; i < bufferSize; i++) {
-    memory[0x200 + i] = buffer[i];
-  }
-
+  memory.Map(SharedImage(romPath, rom, romSize));
+  programEnd = PROGRAM_START + romSize;
   rom.close();
-  delete[] buffer;
 
+  if (!frameReported) SetStartupTime(STARTUP_ROM, Scheduler::Now() - start);
   return 1; 
 }
 
+void Chip8::SetQuirkProfile(int profile) {
+  quirkProfile = profile;
+  opcodeTable = opcodeTables[profile];
+}
+
+// Grows memory to MegaChip's 16 MB or back to 64 KB. The first 64 KB is kept either way, and the
+// extension reads as the ROM image (or zeros) until written. The MegaChip display's buffers
+// come and go with it, and a 24-bit I is cut back to the smaller address space.
+void Chip8::SetMegaChip(bool enabled) {
+  megaChip = enabled;
+  if (!enabled) megaMode = false;
+  state.I &= AddressMask();
+  memory.Resize(AddressMask() + 1);
+  mega.SetAllocated(enabled);
+}
+
+// Makes this machine a copy of `other` (e.g. to fork a search from it). Registers and display
+// are copied whole; memory shares every page neither machine has written since the ROM loaded.
+// The clock settings, step phase and 1802 registers come along too, so the copy steps exactly
+// like the original; its buzzer is then switched to match the copied sound state.
+void Chip8::CloneFrom(const Chip8 &other) {
+  state = other.state;
+  memory = other.memory;
+  programEnd = other.programEnd;
+  superChip = other.superChip;
+  xoChip = other.xoChip;
+  megaChip = other.megaChip;
+  megaMode = other.megaMode;
+  spriteWidth = other.spriteWidth;
+  spriteHeight = other.spriteHeight;
+  mega = other.mega;
+  SetQuirkProfile(other.quirkProfile);
+  std::copy(other.rplFlags, other.rplFlags + RPL_FLAGS, rplFlags);
+  std::copy(other.audioPattern, other.audioPattern + PATTERN_BYTES, audioPattern);
+  audioPitch = other.audioPitch;
+  paused = other.paused;
+  waitingForKey = other.waitingForKey;
+  waitingForVblank = other.waitingForVblank;
+  waitRegister = other.waitRegister;
+  keyPressed = other.keyPressed;
+  idleSkip = other.idleSkip;
+  idleLoopHead = other.idleLoopHead;
+  idleLoopI = other.idleLoopI;
+  idleLoopSP = other.idleLoopSP;
+  std::copy(other.idleLoopV, other.idleLoopV + 16, idleLoopV);
+  cyclesPerSecond = other.cyclesPerSecond;
+  vipTiming = other.vipTiming;
+  cycles = other.cycles;
+  cycleTarget = other.cycleTarget;
+  cycleRemainder = other.cycleRemainder;
+  stepCount = other.stepCount;
+  instructions = other.instructions;
+  stepSample = other.stepSample;
+  cpu->CloneFrom(*other.cpu);
+  UpdateSound();
+}
+
+bool Chip8::ServeMetrics(const char *socketPath) {
+  if (!metrics) {
+    std::cout << "Metrics are only kept for windowed machines\n";
+    return false;
+  }
+  return metrics->Serve(socketPath);
+}
+
 void Chip8::StartMainLoop() {
-  Byte soundPlaying = 0;
+  uint64_t frameStart = Scheduler::Now();
+  scheduler.Reset(frameStart, STEP_FREQUENCY);
   while (!glfwWindowShouldClose(screen->window)) {
-    screen->Draw();
+    // Event Handling: block on input while idle, otherwise sleep until the next step is due
+    // (halted on Fx0A with both timers expired, nothing can change until a key arrives)
+    if (paused || (waitingForKey && !state.delayTimer && !state.soundTimer)) {
+      screen->WaitEvents(double(IDLE_WAIT) / NANOSECONDS);
+      scheduler.Resync(scheduler.Clock());
+    } else if (!screen->Focused()) {
+      screen->WaitEvents(double(scheduler.TimeUntilStep(scheduler.Clock())) / NANOSECONDS);
+    } else {
+      // Without vsync pacing the swaps, hold presents to the display's refresh cadence
+      // (an unlimited clock already runs up to each step deadline, so it just follows the steps)
+      if (!scheduler.VsyncActive() && !turboMax) {
+        if (cyclesPerSecond == UNLIMITED_CYCLES) scheduler.SleepUntilStep();
+        else screen->pacer.SleepUntilPresent();
+      }
+      screen->PollEvents();
+    }
+    // An unlimited clock or turbo at max speed fills every moment, so don't let vsync block it
+    screen->SetVsync(cyclesPerSecond != UNLIMITED_CYCLES && !turboMax);
+    ProcessInput();
+    turboActive = turbo || turboHeld;
+    turboMax = turboActive && turboSpeed == TURBO_MAX;
 
-    if (paused) continue;
+    // Audio-master sync: once the device clock is running, steps fall due on its consumed-sample
+    // clock instead of host time (switching clocks restarts the grid on the new one)
+    bool audioClock = audioSync && buzzer->ClockValid();
+    scheduler.SetClockOffset(audioClock ? buzzer->ClockOffset() : 0);
+    if (audioClock != audioClocked) {
+      scheduler.Resync(scheduler.Clock());
+      audioClocked = audioClock;
+    }
 
-    UpdateTimers();
+    // Pausing or fast-forwarding silences the buzzer; resuming picks the tone back up
+    UpdateSound();
 
-    // Buzzer Control
-    if (soundTimer > 0 && !soundPlaying) {
-      buzzer->Play();
-      soundPlaying = 1;
-    }
-    else {
-      buzzer->Stop();
-      soundPlaying = 0;
+    if (!paused) {
+      // Fixed Timestep: every step that fell due while sleeping or blocked on vsync runs one
+      // emulated step, or turboSpeed of them while fast-forwarding
+      uint64_t dropped;
+      int steps = scheduler.DueSteps(scheduler.Clock(), &dropped);
+      metrics->AddDroppedFrames(dropped / STEPS_PER_TIMER_TICK);
+      for (int i = 0; i < steps; i++) {
+        scheduler.CompleteStep();
+        for (int j = 0; j < (turboActive && !turboMax ? turboSpeed : 1); j++) {
+          RunStep();
+        }
+      }
+      // As fast as possible: keep running whole steps until it's time to present the latest one
+      if (turboMax) {
+        uint64_t presentAt = Scheduler::Now() + TURBO_PRESENT_INTERVAL;
+        while (!waitingForKey && Scheduler::Now() < presentAt) {
+          RunStep();
+        }
+      }
     }
-    
-    lastTime = glfwGetTime();
 
-    // Display Refresh
-    if (elapsedTime < DISPLAY_FREQUENCY) continue;
-    Tick();
-    soundTimer = soundTimer > 0 ? soundTimer - 1 : 0;
-    delayTimer = delayTimer > 0 ? delayTimer - 1 : 0;
-    elapsedTime = 0;
+    screen->Draw();
+    scheduler.RecordSwap(screen->SwapTime());
+    if (!audioReported) ReportStartup();
+
+    // Host Frame Metrics
+    uint64_t frameEnd = Scheduler::Now();
+    metrics->AddHostFrame(float(frameEnd - frameStart) / NANOSECONDS);
+    metrics->SetTraceOccupancy(screen->LogSize(), LOG_CAPACITY);
+    scheduler.SampleCpuUsage(frameEnd);
+    metrics->SetCpuUsage(scheduler.CpuUsage());
+    metrics->SetPresentation(screen->pacer.RefreshRate(), screen->pacer.Jitter());
+    frameStart = frameEnd;
+  }
+}
+
+// Runs `frames` emulated frames back to back with no window, scheduler or input, as fast as the
+// host allows. Audio follows emulated time, so offline backends capture it exactly. Returns the
+// number of frames run, which is short if the ROM halts on Fx0A with nothing left to wait for.
+uint64_t Chip8::RunHeadless(uint64_t frames) {
+  uint64_t frame = 0;
+  if (cyclesPerSecond == UNLIMITED_CYCLES) {
+    std::cout << "Headless runs need a finite clock rate\n";
+    return 0;
+  }
+  for (; frame < frames && !paused && !(waitingForKey && !state.delayTimer && !state.soundTimer); frame++) {
+    RunFrame();
   }
+  // End any tone still sounding at the last emulated sample, then flush it
+  if (soundOn) buzzer->QueueEvent(stepSample, false);
+  soundOn = false;
+  buzzer->SetEmulatedTime(stepSample);
+  return frame;
+}
+
+// Runs one emulated frame of STEPS_PER_TIMER_TICK steps, even when halted on Fx0A (time keeps
+// passing, as it does for a LaneCore)
+void Chip8::RunFrame() {
+  for (int i = 0; i < STEPS_PER_TIMER_TICK; i++) {
+    RunStep();
+  }
+}
+
+// Runs one emulated step: an instruction batch, then the 60 Hz timers every STEPS_PER_TIMER_TICK
+// steps (in VIP mode the timers follow the emulated cycle counter instead)
+void Chip8::RunStep() {
+  stepSample = stepCount * SAMPLE_RATE / STEP_FREQUENCY;
+  stepStart = vipTiming ? cycles : instructions;
+  stepBudget = vipTiming ? VIP_CYCLES_PER_FRAME / STEPS_PER_TIMER_TICK : cyclesPerSecond / STEP_FREQUENCY;
+  bool timerTick = ++stepCount % STEPS_PER_TIMER_TICK == 0;
+  if (vipTiming)
+    timerTick = TickVIP();
+  else
+    Tick();
+  // Anything after the batch happens at the end of the step
+  stepSample = stepCount * SAMPLE_RATE / STEP_FREQUENCY;
+  stepBudget = 0;
+  buzzer->SetEmulatedTime(stepSample);
+  if (!timerTick) return;
+  waitingForVblank = false;
+  idleLoopHead = -1;
+  if (metrics && state.soundTimer > 0) metrics->AddSoundTime(1.0f / TIMER_FREQUENCY);
+  state.soundTimer = state.soundTimer > 0 ? state.soundTimer - 1 : 0;
+  UpdateSound();
+  state.delayTimer = state.delayTimer > 0 ? state.delayTimer - 1 : 0;
+  if (heatmap) heatmap->Decay();
+  if (screen) screen->CaptureFrame(Scheduler::Now());
+  if (metrics) metrics->AddFrame();
 }
 
-void Chip8::UpdateTimers() {
-  currentTime = glfwGetTime();
-  deltaTime = currentTime - lastTime;
-  elapsedTime += deltaTime;
+// Emulated time of the current instruction on the audio sample clock: the start of the step plus
+// how far through its instruction (or VIP cycle) budget the batch has got
+uint64_t Chip8::SoundClock() {
+  if (!stepBudget) return stepSample;
+  uint64_t done = std::min((vipTiming ? cycles : instructions) - stepStart, stepBudget);
+  return stepSample + done * SAMPLE_RATE / (STEP_FREQUENCY * stepBudget);
 }
 
+// Hands buzzer on/off changes to the audio thread, stamped so they start on the exact sample
+void Chip8::UpdateSound() {
+  // Fast-forwarding only mutes a live device; offline captures keep every tone
+  bool on = (state.soundTimer > 0 || cpu->Speaker()) && !paused && !(turboActive && buzzer->Realtime());
+  if (on == soundOn) return;
+  soundOn = on;
+  buzzer->QueueEvent(SoundClock(), on);
+}
+
+// Runs this step's share of cyclesPerSecond in one batch. Only the last LOG_CAPACITY instructions
+// are logged, since earlier entries would be rotated out of the log before anyone sees them.
 void Chip8::Tick() {
-  for (int i = 0; i < instructionFrequency; i++) {
-    UpdateTimers();
+  uint64_t executed = 0;
+  idling = false;
+
+  // Unlimited: run in fixed-size batches until the next step is due, without logging. Fast-forward
+  // runs many steps per deadline, so each of those gets one batch instead (otherwise every step
+  // after the first would find the deadline passed and tick the timers with no instructions run).
+  if (cyclesPerSecond == UNLIMITED_CYCLES) {
+    uint64_t deadline = scheduler.NextStepDeadline();
+    logging = false;
+    if (turboActive) {
+      executed = Run(UNLIMITED_BATCH);
+    } else {
+      while (!waitingForKey && !waitingForVblank && !idling && scheduler.Clock() < deadline) {
+        executed += Run(UNLIMITED_BATCH);
+      }
+    }
+    logging = !headless;
+    if (metrics) metrics->AddInstructions(executed);
+    return;
+  }
+
+  // Integer remainder carries the fractional instruction between steps, so the rate is exact
+  cycleRemainder += cyclesPerSecond;
+  uint64_t budget = cycleRemainder / STEP_FREQUENCY;
+  uint64_t quiet = budget > LOG_CAPACITY ? budget - LOG_CAPACITY : 0;
+  cycleRemainder %= STEP_FREQUENCY;
+
+  logging = false;
+  executed = Run(quiet);
+  logging = !headless;
+  if (executed == quiet) executed += Run(budget - quiet);
+  if (metrics) metrics->AddInstructions(executed);
+}
+
+// Executes up to `count` instructions, stopping early when halted on Fx0A or waiting for vblank.
+// Idle loops are credited without being run: until the delay timer ticks every pass is the same
+// IDLE_LOOP_LENGTH instructions, so skipping whole passes leaves the machine (pc included) exactly
+// where running them would. The idle snapshot lasts until the next tick, so the frame's later
+// steps skip from their first pass.
+uint64_t Chip8::Run(uint64_t count) {
+  uint64_t executed = 0;
+  while (executed < count && !waitingForKey && !waitingForVblank) {
+    // Only Fx07 can start a delay-timer polling loop, so the check costs one compare otherwise
+    if (idleSkip && memory[(state.pc + 1) % MEMORY] == 0x07 && (memory[state.pc] & 0xF0) == 0xF0 && InIdleLoop()) {
+      uint64_t skipped = (count - executed) / IDLE_LOOP_LENGTH * IDLE_LOOP_LENGTH;
+      idling = true;
+      if (skipped) {
+        instructions += skipped;
+        executed += skipped;
+        if (metrics) metrics->AddSkippedInstructions(skipped);
+        continue;
+      }
+    }
     EmulateCycle();
-    lastTime = glfwGetTime();
+    executed++;
   }
+  return executed;
+}
+
+// COSMAC VIP timing: runs instructions until this step's share of the frame's machine cycles is
+// used up. Returns true when the cycle counter crosses a frame boundary, which ticks the timers.
+bool Chip8::TickVIP() {
+  uint64_t frame = cycles / VIP_CYCLES_PER_FRAME;
+  int executed = 0;
+  logging = !headless;
+  cycleTarget += VIP_CYCLES_PER_FRAME / STEPS_PER_TIMER_TICK;
+  for (; cycles < cycleTarget && !waitingForKey; executed++) {
+    EmulateCycle();
+  }
+  // Time keeps passing while halted on Fx0A
+  if (waitingForKey) cycles = std::max(cycles, cycleTarget);
+  if (metrics) metrics->AddInstructions(executed);
+  return cycles / VIP_CYCLES_PER_FRAME != frame;
+}
+
+// Detects `Fx07; 3xkk/4xkk; 1nnn` loops that jump back to the Fx07 at pc. The loop is idle
+// once a full iteration within the same frame leaves every register but pc unchanged.
+bool Chip8::InIdleLoop() {
+  if (state.pc + 5 >= MEMORY) return false;
+  Byte x = memory[state.pc] & 0x0F;
+  Word skip = (memory[state.pc + 2] << 8) | memory[state.pc + 3];
+  Word jump = (memory[state.pc + 4] << 8) | memory[state.pc + 5];
+  if ((skip >> 12 != 0x3 && skip >> 12 != 0x4) || ((skip & 0x0F00) >> 8) != x) return false;
+  if (jump != (0x1000 | state.pc)) return false;
+
+  if (idleLoopHead == state.pc && idleLoopI == state.I && idleLoopSP == state.sp && std::equal(state.V, state.V + 16, idleLoopV))
+    return true;
+  idleLoopHead = state.pc;
+  idleLoopI = state.I;
+  idleLoopSP = state.sp;
+  std::copy(state.V, state.V + 16, idleLoopV);
+  return false;
 }
 
 void Chip8::EmulateCycle() {
-  opcode = (memory[pc] << 8) | memory[pc + 1];
+  // Halted on Fx0A until SetKey delivers a press
+  if (waitingForKey) return;
 
-  // Process input before decoding
-  ProcessInput();
+  state.opcode = (memory[state.pc] << 8) | memory[(state.pc + 1) % MEMORY];
+  cycles += vipCycleTable[((state.opcode & 0xF000) >> 4) | (state.opcode & 0x00FF)];
+  instructions++;
+  Heat(HEAT_EXECUTE, state.pc);
+  Heat(HEAT_EXECUTE, state.pc + 1);
 
   // Decode Instructions
-  (this->*opcodeTable[(opcode & 0xF000) >> 12])();
+  (this->*opcodeTable[(state.opcode & 0xF000) >> 12])();
 }
 
 void Chip8::ProcessInput() {
+  for (int i = 0; i < 16; i++) {
+    SetKey(i, glfwGetKey(screen->window, virtualKeys[i]) == GLFW_PRESS);
+  }
+  turboHeld = glfwGetKey(screen->window, TURBO_KEY) == GLFW_PRESS;
+}
+
+// Updates a key's state; any held key releases the core from an Fx0A wait
+void Chip8::SetKey(Byte k, bool pressed) {
+  state.key[k & 0xF] = pressed;
   keyPressed = -1;
   for (int i = 0; i < 16; i++) {
-    if (glfwGetKey(screen->window, virtualKeys[i]) == GLFW_PRESS) {
-      key[i] = 1;
-      keyPressed = i;
-    } else {
-      key[i] = 0;
-    }
+    if (state.key[i]) keyPressed = i;
+  }
+  if (waitingForKey && pressed) {
+    state.V[waitRegister] = k & 0xF;
+    waitingForKey = false;
+    entry << "Key " << Utilities::FormatHex(1, int(state.V[waitRegister])) << " pressed, resuming at " << Utilities::FormatHex(3, state.pc);
+    Log();
   }
 }
 
+// Pushes the entry built by the current instruction to the debugger log
+void Chip8::Log() {
+  if (screen) screen->PushToLog(entry.str());
+  entry.str("");
+}
+
 void Chip8::op0xxx() {
-  std::stringstream entry;
-  switch (opcode) {
-    // 0x00E0 - Clear Screen
+  if (megaChip && MegaInstruction()) {
+    if (logging) Log();
+    return;
+  }
+  switch (state.opcode) {
+    // 0x00E0 - Clear Screen (the selected planes)
     case 0x00E0:
-      entry << "0x00E0 CLS           |\tClearing Screen";
-      std::fill(display, display + (DISPLAY_WIDTH * DISPLAY_HEIGHT), 0);
-      pc += 2;
+      for (int p = 0; p < DISPLAY_PLANES; p++) {
+        if (state.planeMask & (1 << p)) std::fill(state.planes[p], state.planes[p] + DISPLAY_HEIGHT, 0);
+      }
+      state.pc += 2;
+      if (logging) entry << "0x00E0 CLS           |\tClearing Screen";
       break;
     // 0x00EE - Return
     case 0x00EE:
-      entry << "0x00EE RET           |\t";
-      if (sp <= 0) {
-        entry << "Stack Underflow! SP = " << int(sp);
+      if (logging) entry << "0x00EE RET           |\t";
+      if (state.sp <= 0) {
+        if (logging) entry << "Stack Underflow! SP = " << int(state.sp);
         break;
       }
-      stack[sp] = 0;
-      pc = stack[--sp] + 2;
-      entry << "Returning to " << Utilities::FormatHex(3, pc);
+      state.stack[state.sp] = 0;
+      state.pc = state.stack[--state.sp] + 2;
+      if (logging) entry << "Returning to " << Utilities::FormatHex(3, state.pc);
+      break;
+    // 0x00FB - Scroll right 4 pixels
+    case 0x00FB:
+      if (!superChip) break;
+      Scroll(4, 0);
+      state.pc += 2;
+      if (logging) entry << "0x00FB SCR           |\tScrolling right 4 pixels";
+      break;
+    // 0x00FC - Scroll left 4 pixels
+    case 0x00FC:
+      if (!superChip) break;
+      Scroll(-4, 0);
+      state.pc += 2;
+      if (logging) entry << "0x00FC SCL           |\tScrolling left 4 pixels";
+      break;
+    // 0x00FD - Exit the interpreter (halts here, as if paused)
+    case 0x00FD:
+      if (!superChip) break;
+      paused = true;
+      if (logging) entry << "0x00FD EXIT          |\tProgram exited";
+      break;
+    // 0x00FE - Lo-res (64x32); XO-CHIP also clears every plane
+    case 0x00FE:
+      if (!superChip) break;
+      state.hires = false;
+      if (xoChip) std::fill(&state.planes[0][0], &state.planes[0][0] + DISPLAY_PLANES * DISPLAY_HEIGHT, 0);
+      state.pc += 2;
+      if (logging) entry << "0x00FE LOW           |\tLo-res mode";
+      break;
+    // 0x00FF - Hi-res (128x64); XO-CHIP also clears every plane
+    case 0x00FF:
+      if (!superChip) break;
+      state.hires = true;
+      if (xoChip) std::fill(&state.planes[0][0], &state.planes[0][0] + DISPLAY_PLANES * DISPLAY_HEIGHT, 0);
+      state.pc += 2;
+      if (logging) entry << "0x00FF HIGH          |\tHi-res mode";
+      break;
+    default: {
+      Byte n = state.opcode & 0x000F;
+      // 0x00Cn - Scroll down n pixels
+      if (superChip && (state.opcode & 0xFFF0) == 0x00C0) {
+        Scroll(0, n);
+        state.pc += 2;
+        if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SCD n         |\tScrolling down " << int(n) << " pixels";
+      }
+      // 0x00Dn - Scroll up n pixels (XO-CHIP)
+      else if (xoChip && (state.opcode & 0xFFF0) == 0x00D0) {
+        Scroll(0, -n);
+        state.pc += 2;
+        if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SCU n         |\tScrolling up " << int(n) << " pixels";
+      }
+      // 0x0nnn - Call the RCA 1802 machine-code routine at nnn (hybrid COSMAC VIP ROMs). Only
+      // targets inside the loaded program are plausible; anything else (0000 in blank memory,
+      // most often) halts on the opcode as before.
+      else if ((quirkProfile == QUIRKS_CHIP8 || quirkProfile == QUIRKS_VIP) &&
+               (state.opcode & 0x0FFF) >= PROGRAM_START && (state.opcode & 0x0FFF) < programEnd) {
+        MachineCall(state.opcode & 0x0FFF);
+      }
       break;
+    }
+  }
+  if (logging) Log();
+}
+
+// 0x0nnn - Runs the machine-code routine at nnn the way the COSMAC VIP interpreter calls it. V,
+// the timers and the lo-res display are mirrored into the interpreter's work areas first, and the
+// 1802 starts with the registers the interpreter leaves behind (R5 = CHIP-8 pc, R6/R7 = &Vx/&Vy,
+// R8 = timers, RA = I, RB = display page). Whatever the routine leaves there is read back once it
+// returns with SEP R4, and its machine cycles are charged to the VIP cycle count.
+void Chip8::MachineCall(Word address) {
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  Byte y = (state.opcode & 0x00F0) >> 4;
+  memory.Write(VIP_REGISTERS, state.V, 16);
+  if (!state.hires) ExportVipDisplay();
+  cpu->R[0x0] = VIP_DISPLAY;
+  cpu->R[0x2] = VIP_STACK_POINTER;
+  cpu->R[0x5] = state.pc + 2;
+  cpu->R[0x6] = VIP_REGISTERS + x;
+  cpu->R[0x7] = VIP_REGISTERS + y;
+  cpu->R[0x8] = (state.delayTimer << 8) | state.soundTimer;
+  cpu->R[0xA] = state.I & 0xFFFF;
+  cpu->R[0xB] = VIP_DISPLAY;
+  uint64_t spent = cpu->Call(address, cycles);
+  cycles += spent;
+
+  memory.Read(VIP_REGISTERS, state.V, 16);
+  if (!state.hires) ImportVipDisplay();
+  state.delayTimer = cpu->R[0x8] >> 8;
+  state.soundTimer = cpu->R[0x8] & 0xFF;
+  state.I = cpu->R[0xA] & AddressMask();
+  state.pc = cpu->R[0x5];
+  UpdateSound();
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " SYS nnn       |\t";
+  if (cpu->Returned())
+    entry << "Ran 1802 routine at " << Utilities::FormatHex(3, address) << " for " << spent << " cycles";
+  else
+    entry << "1802 routine at " << Utilities::FormatHex(3, address) << " did not return";
+}
+
+// Packs plane 0 at lo-res into the VIP's 1-bit display page (one display row per lo-res row)
+void Chip8::ExportVipDisplay() {
+  for (int y = 0; y < LORES_HEIGHT; y++) {
+    DisplayRow row = state.planes[0][y * 2];
+    for (int b = 0; b < LORES_WIDTH / 8; b++) {
+      unsigned doubled = unsigned(row >> (DISPLAY_WIDTH - 16 * (b + 1))) & 0xFFFF;
+      Byte bits = 0;
+      for (int i = 0; i < 8; i++) {
+        bits |= ((doubled >> (i * 2)) & 1) << i;
+      }
+      memory.Write(VIP_DISPLAY + y * 8 + b, bits);
+    }
   }
-  screen->PushToLog(entry.str());
+}
+
+// Unpacks the VIP display page back into plane 0, doubling each pixel
+void Chip8::ImportVipDisplay() {
+  for (int y = 0; y < LORES_HEIGHT; y++) {
+    DisplayRow row = 0;
+    for (int b = 0; b < LORES_WIDTH / 8; b++) {
+      row |= DisplayRow(spreadTable[memory[VIP_DISPLAY + y * 8 + b]]) << (DISPLAY_WIDTH - 16 * (b + 1));
+    }
+    state.planes[0][y * 2] = state.planes[0][y * 2 + 1] = row;
+  }
+}
+
+// MegaChip instructions in the 0nnn space, and the display instructions that act on the MegaChip
+// display while it is switched in. Returns false for anything left to op0xxx.
+bool Chip8::MegaInstruction() {
+  Byte nn = state.opcode & 0x00FF;
+  Byte n = state.opcode & 0x000F;
+  switch (state.opcode & 0xFF00) {
+    case 0x0000:
+      // 0x0010 / 0x0011 - Switch the MegaChip display out / in
+      if (state.opcode == 0x0010 || state.opcode == 0x0011) {
+        megaMode = state.opcode == 0x0011;
+        mega.Clear();
+        mega.Present();
+        state.pc += 2;
+        if (logging) entry << Utilities::FormatHex(4, state.opcode) << (megaMode ? " MEGAON        |\tMegaChip display" : " MEGAOFF       |\tCHIP-8 display");
+        return true;
+      }
+      if (!megaMode) return false;
+      // 0x00E0 - Present the frame drawn since the last one, and start a blank one
+      if (state.opcode == 0x00E0) {
+        mega.Present();
+        mega.Clear();
+        if (logging) entry << "0x00E0 CLS           |\tPresenting frame";
+      }
+      // 0x00Bn / 0x00Cn - Scroll up / down n pixels
+      else if ((state.opcode & 0xFFF0) == 0x00B0 || (state.opcode & 0xFFF0) == 0x00C0) {
+        mega.Scroll(0, (state.opcode & 0xFFF0) == 0x00B0 ? -n : n);
+        if (logging) entry << Utilities::FormatHex(4, state.opcode) << ((state.opcode & 0xFFF0) == 0x00B0 ? " SCU n" : " SCD n") << "         |\tScrolling " << int(n) << " pixels";
+      }
+      // 0x00FB / 0x00FC - Scroll right / left 4 pixels
+      else if (state.opcode == 0x00FB || state.opcode == 0x00FC) {
+        mega.Scroll(state.opcode == 0x00FB ? 4 : -4, 0);
+        if (logging) entry << Utilities::FormatHex(4, state.opcode) << (state.opcode == 0x00FB ? " SCR" : " SCL") << "           |\tScrolling 4 pixels";
+      }
+      else return false;
+      state.pc += 2;
+      return true;
+    // 0x01nn nnnn - Load the 24-bit address nnnnnn into I
+    case 0x0100:
+      state.I = (nn << 16) | (memory[(state.pc + 2) % MEMORY] << 8) | memory[(state.pc + 3) % MEMORY];
+      Heat(HEAT_EXECUTE, state.pc + 2);
+      Heat(HEAT_EXECUTE, state.pc + 3);
+      state.pc += 4;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LDHI I, nnnnnn|\tI = " << Utilities::FormatHex(6, state.I);
+      return true;
+    // 0x02nn - Load palette entries 1 to nn from ARGB quadruples at memory[I] onwards
+    case 0x0200: {
+      Byte argb[256 * 4];
+      uint32_t count = std::min<uint32_t>(nn, (MEGA_MEMORY - state.I) / 4);
+      memory.Read(state.I, argb, count * 4);
+      mega.LoadPalette(argb, count);
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LDPAL nn      |\tLoaded " << int(nn) << " colours from " << Utilities::FormatHex(6, state.I);
+      break;
+    }
+    // 0x03nn / 0x04nn - Set the sprite width / height to nn (0 means 256)
+    case 0x0300:
+      spriteWidth = nn ? nn : 256;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SPRW nn       |\tSprite width = " << spriteWidth;
+      break;
+    case 0x0400:
+      spriteHeight = nn ? nn : 256;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SPRH nn       |\tSprite height = " << spriteHeight;
+      break;
+    // 0x05nn - Set the screen alpha (fade) to nn
+    case 0x0500:
+      mega.SetAlpha(nn);
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " ALPHA nn      |\tScreen alpha = " << int(nn);
+      break;
+    // 0x060n - Play the digitised sound at I, looping when n = 0
+    case 0x0600:
+      if (nn > 0x0F) return false;
+      PlaySample();
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " DIGISND n     |\tPlaying sample at " << Utilities::FormatHex(6, state.I);
+      break;
+    // 0x0700 - Stop the digitised sound
+    case 0x0700:
+      if (nn) return false;
+      buzzer->QueueSampleStop(SoundClock());
+      if (logging) entry << "0x0700 STOPSND       |\tStopped sample";
+      break;
+    // 0x080n - Set the sprite blend mode (normal, 25%, 50%, 75%, add, multiply)
+    case 0x0800:
+      if (nn > 0x0F) return false;
+      mega.SetBlendMode(n);
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " BMODE n       |\tBlend mode = " << mega.BlendMode();
+      break;
+    // 0x09nn - Report collisions with pixels drawn in palette index nn
+    case 0x0900:
+      mega.SetCollisionIndex(nn);
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " CCOL nn       |\tCollision index = " << int(nn);
+      break;
+    default:
+      return false;
+  }
+  state.pc += 2;
+  return true;
+}
+
+// 0x060n - Starts the digitised sound at I: a 16-bit sample rate, a 24-bit length and a reserved
+// byte, then unsigned 8-bit samples. The samples are copied out, so the program may reuse the
+// memory while they play.
+void Chip8::PlaySample() {
+  unsigned rate = (memory[state.I] << 8) | memory[(state.I + 1) & AddressMask()];
+  uint32_t length = (memory[(state.I + 2) & AddressMask()] << 16) | (memory[(state.I + 3) & AddressMask()] << 8) | memory[(state.I + 4) & AddressMask()];
+  uint32_t start = std::min<uint32_t>(state.I + MEGA_SAMPLE_HEADER, MEGA_MEMORY);
+  length = std::min<uint32_t>(length, MEGA_MEMORY - start);
+  std::vector<uint8_t> samples(length);
+  memory.Read(start, samples.data(), length);
+  auto data = std::make_shared<const std::vector<uint8_t>>(std::move(samples));
+  buzzer->QueueSample(SoundClock(), std::move(data), rate, (state.opcode & 0x000F) == 0);
+}
+
+// MegaChip Dxyn: draws a spriteWidth x spriteHeight sprite of palette indices from I at
+// (x, y), ignoring n. V[0xF] reports a collision with the collision index.
+void Chip8::DrawMegaSprite(Byte x, Byte y) {
+  if (!spriteWidth || !spriteHeight) {
+    state.V[0xF] = 0;
+    return;
+  }
+  int rows = std::min<uint32_t>(spriteHeight, (MEGA_MEMORY - state.I) / spriteWidth);
+  spriteBuffer.resize(spriteWidth * rows);
+  memory.Read(state.I, spriteBuffer.data(), spriteWidth * rows);
+  state.V[0xF] = mega.DrawSprite(x, y, spriteBuffer.data(), spriteWidth, rows);
+}
+
+// Scrolls the selected planes by (dx, dy) pixels, filling with blank pixels. SUPER-CHIP 1.1
+// scrolls by display pixels even in lo-res (half a lo-res pixel, as on the HP48); XO-CHIP
+// scrolls by pixels of the current resolution.
+void Chip8::Scroll(int dx, int dy) {
+  int scale = xoChip && !state.hires ? 2 : 1;
+  dx *= scale;
+  dy *= scale;
+  for (int p = 0; p < DISPLAY_PLANES; p++) {
+    if (!(state.planeMask & (1 << p))) continue;
+    DisplayRow *rows = state.planes[p];
+    for (int y = 0; y < DISPLAY_HEIGHT; y++) {
+      rows[y] = dx >= 0 ? rows[y] >> dx : rows[y] << -dx;
+    }
+    if (dy > 0) {
+      std::copy_backward(rows, rows + DISPLAY_HEIGHT - dy, rows + DISPLAY_HEIGHT);
+      std::fill(rows, rows + dy, 0);
+    } else if (dy < 0) {
+      std::copy(rows - dy, rows + DISPLAY_HEIGHT, rows);
+      std::fill(rows + DISPLAY_HEIGHT + dy, rows + DISPLAY_HEIGHT, 0);
+    }
+  }
+}
+
+// Palette index of a pixel: bit p comes from plane p
+int Chip8::Pixel(int x, int y) {
+  int index = 0;
+  for (int p = 0; p < DISPLAY_PLANES; p++) {
+    index |= int((state.planes[p][y] >> (DISPLAY_WIDTH - 1 - x)) & 1) << p;
+  }
+  return index;
+}
+
+// Where Fx55/Fx65 leave I after transferring V[0] to V[x]
+template <typename Quirks>
+void Chip8::AdvanceI(Byte x) {
+  if constexpr (Quirks::memory == MEMORY_INCREMENT)
+    state.I = (state.I + x + 1) & AddressMask();
+  else if constexpr (Quirks::memory == MEMORY_INCREMENT_X)
+    state.I = (state.I + x) & AddressMask();
+}
+
+// Bytes from pc to the instruction after next. XO-CHIP's F000 nnnn and MegaChip's 01nn nnnn are
+// four bytes long, and skips step over all of it.
+Word Chip8::SkipSize() {
+  Word next = state.pc + 2;
+  if (xoChip && memory[next] == 0xF0 && memory[(next + 1) % MEMORY] == 0x00) return 6;
+  if (megaChip && memory[next] == 0x01) return 6;
+  return 4;
 }
 
 // 0x1nnn - Jump to address nnn
 void Chip8::op1xxx() {
-  std::stringstream entry;
-  pc = opcode & 0x0FFF;
-  entry << Utilities::FormatHex(4, opcode) << " JP nnn        |\tSetting PC to: " << Utilities::FormatHex(3, pc);
-  screen->PushToLog(entry.str());
+  state.pc = state.opcode & 0x0FFF;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " JP nnn        |\tSetting PC to: " << Utilities::FormatHex(3, state.pc);
+  Log();
 }
 
 // 0x2nnn - Call function at nnn
 void Chip8::op2xxx() {
-  std::stringstream entry;
-  entry << Utilities::FormatHex(4, opcode) << " CALL nnn      |\t";
-  if (sp >= 16) {
-    entry << "Stack Overflow! SP = " << int(sp);
-    pc += 2;
+  if (logging) entry << Utilities::FormatHex(4, state.opcode) << " CALL nnn      |\t";
+  if (state.sp >= 16) {
+    if (logging) entry << "Stack Overflow! SP = " << int(state.sp);
+    state.pc += 2;
+    entry.str("");
     return;
   }
-  stack[sp++] = pc;
-  pc = opcode & 0x0FFF;
-  entry << "Calling function at: " << Utilities::FormatHex(3, pc);
-  screen->PushToLog(entry.str());
+  state.stack[state.sp++] = state.pc;
+  state.pc = state.opcode & 0x0FFF;
+  if (!logging) return;
+  entry << "Calling function at: " << Utilities::FormatHex(3, state.pc);
+  Log();
 }
 
 // 0x3xbb - Skip next instruction if V[x] == bb
 void Chip8::op3xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  entry << Utilities::FormatHex(4, opcode) << " SE Vx, bb     |\t";
-  if (V[x] == (opcode & 0x00FF)) {
-    pc += 2;
-    entry << "Equal, Skipping";
-  } else {
-    entry << "Not Equal, Not Skipping";
-  }
-  pc += 2;
-  screen->PushToLog(entry.str());
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  bool skip = state.V[x] == (state.opcode & 0x00FF);
+  state.pc += skip ? SkipSize() : 2;
+  cycles += skip * VIP_SKIP_CYCLES;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " SE Vx, bb     |\t" << (skip ? "Equal, Skipping" : "Not Equal, Not Skipping");
+  Log();
 }
 
 // 0x4xbb - Skip next instruction if V[x] != bb
 void Chip8::op4xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  entry << Utilities::FormatHex(4, opcode) << " SNE Vx, bb    |\t";
-  if (V[x] != (opcode & 0x00FF)) {
-    pc += 2;
-    entry << "Not Equal, Skipping";
-  } else {
-    entry << "Equal, Not Skipping";
-  }
-  pc += 2;
-  screen->PushToLog(entry.str());
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  bool skip = state.V[x] != (state.opcode & 0x00FF);
+  state.pc += skip ? SkipSize() : 2;
+  cycles += skip * VIP_SKIP_CYCLES;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " SNE Vx, bb    |\t" << (skip ? "Not Equal, Skipping" : "Equal, Not Skipping");
+  Log();
 }
 
-// 0x5xy0 - Skip next instruction if V[x] == V[y]
 void Chip8::op5xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  Byte y = (opcode & 0x00F0) >> 4;
-  entry << Utilities::FormatHex(4, opcode) << " SE Vx, Vy     |\t";
-  if (V[x] == V[y]) {
-    pc += 2;
-    entry << "Equal, Skipping";
-  } else {
-    entry << "Not Equal, Not Skipping";
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  Byte y = (state.opcode & 0x00F0) >> 4;
+  int step = x <= y ? 1 : -1;
+  switch (state.opcode & 0x000F) {
+    // 0x5xy0 - Skip next instruction if V[x] == V[y]
+    case 0x0000: {
+      bool skip = state.V[x] == state.V[y];
+      state.pc += skip ? SkipSize() : 2;
+      cycles += skip * VIP_SKIP_CYCLES;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SE Vx, Vy     |\t" << (skip ? "Equal, Skipping" : "Not Equal, Not Skipping");
+      break;
+    }
+    // 0x5xy2 - Store V[x] to V[y] (in either order) into memory[I] onwards, leaving I unchanged (XO-CHIP)
+    case 0x0002:
+      if (!xoChip) break;
+      for (int i = 0; i <= std::abs(y - x); i++) {
+        memory.Write((state.I + i) & AddressMask(), state.V[x + i * step]);
+        Heat(HEAT_WRITE, state.I + i);
+      }
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SAVE Vx - Vy  |\tSaved V[" << Utilities::FormatHex(1, int(x)) << "] to V[" << Utilities::FormatHex(1, int(y)) << "]";
+      break;
+    // 0x5xy3 - Load V[x] to V[y] (in either order) from memory[I] onwards, leaving I unchanged (XO-CHIP)
+    case 0x0003:
+      if (!xoChip) break;
+      for (int i = 0; i <= std::abs(y - x); i++) {
+        state.V[x + i * step] = memory[(state.I + i) & AddressMask()];
+        Heat(HEAT_READ, state.I + i);
+      }
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LOAD Vx - Vy  |\tLoaded V[" << Utilities::FormatHex(1, int(x)) << "] to V[" << Utilities::FormatHex(1, int(y)) << "]";
+      break;
   }
-  pc += 2;
-  screen->PushToLog(entry.str());
+  if (logging) Log();
 }
 
 // 0x6xbb - Load bb into V[x]
 void Chip8::op6xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  V[x] = opcode & 0x00FF;
-  entry << Utilities::FormatHex(4, opcode) << " LD Vx, bb     |\tLoaded " << int(V[x]) << " into V[" << Utilities::FormatHex(1, int(x)) << "]"; 
-  pc += 2;
-  screen->PushToLog(entry.str());
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  state.V[x] = state.opcode & 0x00FF;
+  state.pc += 2;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " LD Vx, bb     |\tLoaded " << int(state.V[x]) << " into V[" << Utilities::FormatHex(1, int(x)) << "]"; 
+  Log();
 }
 
 // 0x7xbb - Increment V[x] by bb
 void Chip8::op7xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  entry << Utilities::FormatHex(4, opcode) << " ADD Vx, bb    |\tIncrementing V[" << Utilities::FormatHex(1, int(x)) << "] by " << (opcode & 0x00FF); 
-  V[x] += opcode & 0x00FF;
-  pc += 2;
-  screen->PushToLog(entry.str());
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  state.V[x] += state.opcode & 0x00FF;
+  state.pc += 2;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " ADD Vx, bb    |\tIncrementing V[" << Utilities::FormatHex(1, int(x)) << "] by " << (state.opcode & 0x00FF); 
+  Log();
 }
 
+template <typename Quirks>
 void Chip8::op8xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  Byte y = (opcode & 0x00F0) >> 4;
-  std::string xString = Utilities::FormatHex(1, int(x));
-  std::string yString = Utilities::FormatHex(1, int(y));
-  std::string opString = Utilities::FormatHex(4, opcode);
-  switch (opcode & 0x000F) {
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  Byte y = (state.opcode & 0x00F0) >> 4;
+  const char *mnemonic = "";
+  // Flags are worked out from the operands and written last, so V[F] as an operand still works
+  Byte flag;
+  switch (state.opcode & 0x000F) {
     // 0x8xy0 - Load V[y] into V[x]
     case 0x0000:
-      V[x] = V[y];
-      entry << opString << " LD Vx, Vy     |\tLoading " << int(V[x]) << " into V[" << xString << "]"; 
-      pc += 2;
+      state.V[x] = state.V[y];
+      mnemonic = " LD Vx, Vy     |\t";
       break;
     // 0x8xy1 - Set V[x] = V[x] OR V[y]
     case 0x0001:
-      V[x] |= V[y];
-      entry << opString << " OR Vx, Vy     |\tORing V[" << xString << "] and V[" << yString << "] = " << int(V[x]); 
-      pc += 2;
+      state.V[x] |= state.V[y];
+      if constexpr (Quirks::logicResetsVF) state.V[0xF] = 0;
+      mnemonic = " OR Vx, Vy     |\t";
       break;
     // 0x8xy2 - Set V[x] = V[x] AND V[y]
     case 0x0002:
-      V[x] &= V[y];
-      entry << opString << " AND Vx, Vy    |\tANDing V[" << xString << "] and V[" << yString << "] = " << int(V[x]); 
-      pc += 2;
+      state.V[x] &= state.V[y];
+      if constexpr (Quirks::logicResetsVF) state.V[0xF] = 0;
+      mnemonic = " AND Vx, Vy    |\t";
       break;
     // 0x8xy3 - Set V[x] = V[x] XOR V[y]
     case 0x0003:
-      V[x] ^= V[y];
-      entry << opString << " XOR Vx, Vy    |\tXORing V[" << xString << "] and V[" << yString << "] = " << int(V[x]); 
-      pc += 2;
+      state.V[x] ^= state.V[y];
+      if constexpr (Quirks::logicResetsVF) state.V[0xF] = 0;
+      mnemonic = " XOR Vx, Vy    |\t";
       break;
     // 0x8xy4 - Increment V[x] by V[y]
     case 0x0004: {
-      Word sum = V[x] + V[y];
-      V[x] = sum & 0xFF;
-      if (sum > 0xFF)
-        V[0xF] = 1;
-      else
-        V[0xF] = 0;
-      entry << opString << " ADD Vx, Vy    |\tV[" << xString << "] + V[" << yString << "] = " << int(V[x]) << "; V[0xF] = " << int(V[0xF]); 
-      pc += 2;
+      Word sum = state.V[x] + state.V[y];
+      state.V[x] = sum & 0xFF;
+      state.V[0xF] = sum > 0xFF;
+      mnemonic = " ADD Vx, Vy    |\t";
       break;
     }
     // 0x8xy5 - Decrement V[x] by V[y]
     case 0x0005:
-      if (V[x] > V[y]) 
-        V[0xF] = 1;
-      else
-        V[0xF] = 0;
-      V[x] = V[x] - V[y];
-      entry << opString << " SUB Vx, Vy    |\tV[" << xString << "] - V[" << yString << "] = " << int(V[x]) << "; V[0xF] = " << int(V[0xF]); 
-      pc += 2;
-      break;
-    // 0x8xy6 - Shift right V[x] by 1 bit
-    case 0x0006:
-      V[x] = V[x] >> 1;
-      if ((V[x] & 0x01) == 0x01)
-        V[0xF] = 1;
-      else
-        V[0xF] = 0;
-      entry << opString << " SHR Vx        |\tV[" << xString << "] >> 1 = " << int(V[x]) << "; V[0xF] = " << int(V[0xF]); 
-      pc += 2;
+      flag = state.V[x] >= state.V[y];
+      state.V[x] = state.V[x] - state.V[y];
+      state.V[0xF] = flag;
+      mnemonic = " SUB Vx, Vy    |\t";
+      break;
+    // 0x8xy6 - Shift right by 1 bit into V[x]
+    case 0x0006: {
+      Byte source = Quirks::shiftUsesVy ? state.V[y] : state.V[x];
+      state.V[x] = source >> 1;
+      state.V[0xF] = source & 0x01;
+      mnemonic = " SHR Vx, Vy    |\t";
       break;
+    }
     // 0x8xy7 - Set V[x] = V[y] - V[x]
     case 0x0007:
-      V[x] = V[y] - V[x];
-      if (V[y] > V[x])
-        V[0xF] = 1;
-      else
-        V[0xF] = 0;
-      entry << opString << " SUBN Vx, Vy   |\tV[" << yString << "] - V[" << xString << "] = " << int(V[x]) << "; V[0xF] = " << int(V[0xF]); 
-      pc += 2;
+      flag = state.V[y] >= state.V[x];
+      state.V[x] = state.V[y] - state.V[x];
+      state.V[0xF] = flag;
+      mnemonic = " SUBN Vx, Vy   |\t";
       break;
-    // 0x8xyE - Shift left V[x] by 1 bit
-    case 0x000E:
-      V[x] = V[x] << 1;
-      if ((V[x] & 0x80) == 0x80) 
-        V[0xF] = 1;
-      else
-        V[0xF] = 0;
-      entry << opString << " SHL Vx        |\tV[" << xString << "] << 1 = " << int(V[x]) << "; V[0xF] = " << int(V[0xF]); 
-      pc += 2;
+    // 0x8xyE - Shift left by 1 bit into V[x]
+    case 0x000E: {
+      Byte source = Quirks::shiftUsesVy ? state.V[y] : state.V[x];
+      state.V[x] = source << 1;
+      state.V[0xF] = source >> 7;
+      mnemonic = " SHL Vx, Vy    |\t";
       break;
+    }
+  }
+  state.pc += 2;
+  if (!logging) return;
+
+  std::string xString = Utilities::FormatHex(1, int(x));
+  std::string yString = Utilities::FormatHex(1, int(y));
+  entry << Utilities::FormatHex(4, state.opcode) << mnemonic;
+  switch (state.opcode & 0x000F) {
+    case 0x0000: entry << "Loading " << int(state.V[x]) << " into V[" << xString << "]"; break;
+    case 0x0001: entry << "ORing V[" << xString << "] and V[" << yString << "] = " << int(state.V[x]); break;
+    case 0x0002: entry << "ANDing V[" << xString << "] and V[" << yString << "] = " << int(state.V[x]); break;
+    case 0x0003: entry << "XORing V[" << xString << "] and V[" << yString << "] = " << int(state.V[x]); break;
+    case 0x0004: entry << "V[" << xString << "] + V[" << yString << "] = " << int(state.V[x]) << "; V[0xF] = " << int(state.V[0xF]); break;
+    case 0x0005: entry << "V[" << xString << "] - V[" << yString << "] = " << int(state.V[x]) << "; V[0xF] = " << int(state.V[0xF]); break;
+    case 0x0006: entry << "V[" << xString << "] >> 1 = " << int(state.V[x]) << "; V[0xF] = " << int(state.V[0xF]); break;
+    case 0x0007: entry << "V[" << yString << "] - V[" << xString << "] = " << int(state.V[x]) << "; V[0xF] = " << int(state.V[0xF]); break;
+    case 0x000E: entry << "V[" << xString << "] << 1 = " << int(state.V[x]) << "; V[0xF] = " << int(state.V[0xF]); break;
   }
-  screen->PushToLog(entry.str());
+  Log();
 }
 
 // 0x9xy0 - Skip next instruction if V[x] != V[y]
 void Chip8::op9xxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  Byte y = (opcode & 0x00F0) >> 4;
-  entry << Utilities::FormatHex(4, opcode) << " SNE Vx, Vy    |\t";
-  if (V[x] != V[y]) {
-    pc += 2;
-    entry << "Not Equal, Skipping";
-  } else {
-    entry << "Equal, Not Skipping";
-  }
-  pc += 2;
-  screen->PushToLog(entry.str());
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  Byte y = (state.opcode & 0x00F0) >> 4;
+  bool skip = state.V[x] != state.V[y];
+  state.pc += skip ? SkipSize() : 2;
+  cycles += skip * VIP_SKIP_CYCLES;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " SNE Vx, Vy    |\t" << (skip ? "Not Equal, Skipping" : "Equal, Not Skipping");
+  Log();
 }
 
 // 0xAnnn - Load nnn into I
 void Chip8::opAxxx() {
-  std::stringstream entry;
-  I = opcode & 0x0FFF;
-  entry << Utilities::FormatHex(4, opcode) << " LD I, nnn     |\tLoaded " << Utilities::FormatHex(3, I) << " into I";
-  pc += 2;
-  screen->PushToLog(entry.str());
+  state.I = state.opcode & 0x0FFF;
+  state.pc += 2;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " LD I, nnn     |\tLoaded " << Utilities::FormatHex(3, state.I) << " into I";
+  Log();
 }
 
-// 0xBnnn - Jump to address nnn + V[0]
+// 0xBnnn - Jump to address nnn + V[0] (0xBxnn - xnn + V[x] on CHIP-48 and SUPER-CHIP)
+template <typename Quirks>
 void Chip8::opBxxx() {
-  std::stringstream entry;
-  pc = V[0] + opcode & 0x0FFF;
-  entry << Utilities::FormatHex(4, opcode) << " JP V0, addr   |\tSet PC to: " << Utilities::FormatHex(3, pc);
-  screen->PushToLog(entry.str());
+  Byte x = Quirks::jumpUsesVx ? (state.opcode & 0x0F00) >> 8 : 0;
+  state.pc = (state.opcode & 0x0FFF) + state.V[x];
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " JP V" << Utilities::FormatHex(1, int(x)) << ", addr   |\tSet PC to: " << Utilities::FormatHex(3, state.pc);
+  Log();
 }
 
 // 0xCxbb - Set V[x] = rand(0, 255) AND bb
 void Chip8::opCxxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  std::string xString = Utilities::FormatHex(1, int(x));
-  V[x] = (rand() % 256) & (opcode & 0x00FF);
-  entry << Utilities::FormatHex(4, opcode) << " RND Vx, bb    |\tSetting V[" << xString << "] to " << int(V[x]);
-  pc += 2;
-  screen->PushToLog(entry.str());
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  state.V[x] = (rand() % 256) & (state.opcode & 0x00FF);
+  state.pc += 2;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " RND Vx, bb    |\tSetting V[" << Utilities::FormatHex(1, int(x)) << "] to " << int(state.V[x]);
+  Log();
 }
 
-// 0xDxyn - Draw a sprite of n-bytes high at (V[x], V[y])
-void Chip8::opDxxx() {
-  Byte spriteRow;
-  Byte x = V[(opcode & 0x0F00) >> 8] % DISPLAY_WIDTH;
-  Byte y = V[(opcode & 0x00F0) >> 4] % DISPLAY_HEIGHT;
-  Byte height = opcode & 0x000F;
-  std::stringstream entry;
-  V[0xF] = 0;
+// Draws `height` rows of a `width`-pixel (8 or 16) sprite from `address` at (x, y) in the current
+// resolution into one plane, clipping or wrapping at the edges. Each row is one mask XORed into
+// the bit-packed plane; lo-res rows are widened by doubling their bits and cover two display rows.
+// Returns the number of rows that erased a pixel (plus rows clipped off the bottom in hi-res,
+// which SUPER-CHIP counts as collisions).
+template <typename Quirks>
+int Chip8::DrawSprite(DisplayRow *plane, int x, int y, uint32_t address, int height, int width) {
+  int scale = state.hires ? 1 : 2;
+  int bytes = width / 8;
+  int collisions = 0;
   for (int i = 0; i < height; i++) {
-    if (y + i >= DISPLAY_HEIGHT) break;
-    if (I + i >= MEMORY) break;
-    spriteRow = memory[I + i];
-    for (int j = 0; j < 8; j++) {
-      if (x + j >= DISPLAY_WIDTH) break;
-      Byte pixel = (spriteRow & (0x80 >> j)) > 0 ? 1 : 0;
-      if (!pixel) continue;
-      unsigned index = x + j + ((y + i) * DISPLAY_WIDTH);
-      if (display[index] > 0)
-        V[0xF] = 1;
-      display[index] ^= pixel;
+    int row = y + i;
+    if (row * scale >= DISPLAY_HEIGHT) {
+      if constexpr (Quirks::clipSprites) {
+        if (state.hires) collisions += height - i;
+        break;
+      }
+      row %= DISPLAY_HEIGHT / scale;
+    }
+    uint32_t source = (address + i * bytes) & AddressMask();
+    uint32_t bits = memory[source];
+    Heat(HEAT_READ, source);
+    if (bytes == 2) {
+      bits = (bits << 8) | memory[(source + 1) & AddressMask()];
+      Heat(HEAT_READ, source + 1);
+    }
+    if (!state.hires) bits = bytes == 2 ? (spreadTable[bits >> 8] << 16) | spreadTable[bits & 0xFF] : spreadTable[bits];
+    // Left-align the sprite row at column 0, then move it to column x (rotating when wrapping)
+    int column = x * scale;
+    DisplayRow sprite = DisplayRow(bits) << (DISPLAY_WIDTH - width * scale);
+    DisplayRow mask = sprite >> column;
+    if constexpr (!Quirks::clipSprites) {
+      if (column) mask |= sprite << (DISPLAY_WIDTH - column);
+    }
+    bool collided = false;
+    for (int j = 0; j < scale; j++) {
+      DisplayRow &line = plane[row * scale + j];
+      collided |= (line & mask) != 0;
+      line ^= mask;
     }
+    collisions += collided;
   }
-  entry << Utilities::FormatHex(4, opcode) << " DRW Vx, Vy, n |\tDrawing at (" << int(V[x]) << ", " << int(V[y]) << "), height = " << int(height) << "; V[0xF] = " << int(V[0xF]);
-  pc += 2;
-  screen->PushToLog(entry.str());
+  return collisions;
+}
+
+// 0xDxyn - Draw a sprite of n-bytes high at (V[x], V[y]); SUPER-CHIP Dxy0 draws a 16x16 sprite.
+// With several XO-CHIP planes selected, each takes the next sprite's worth of bytes after I.
+template <typename Quirks>
+void Chip8::opDxxx() {
+  if (megaMode) {
+    Byte x = state.V[(state.opcode & 0x0F00) >> 8];
+    Byte y = state.V[(state.opcode & 0x00F0) >> 4];
+    DrawMegaSprite(x, y);
+    state.pc += 2;
+    if (!logging) return;
+    entry << Utilities::FormatHex(4, state.opcode) << " DRW Vx, Vy    |\tDrawing " << spriteWidth << "x" << spriteHeight << " at (" << int(x) << ", " << int(y) << "); V[0xF] = " << int(state.V[0xF]);
+    Log();
+    return;
+  }
+  int scale = state.hires ? 1 : 2;
+  Byte x = state.V[(state.opcode & 0x0F00) >> 8] % (DISPLAY_WIDTH / scale);
+  Byte y = state.V[(state.opcode & 0x00F0) >> 4] % (DISPLAY_HEIGHT / scale);
+  Byte height = state.opcode & 0x000F;
+  bool big = superChip && height == 0;
+  int rows = big ? 16 : height;
+  int width = big ? 16 : 8;
+  int collisions = 0;
+  uint32_t address = state.I;
+  for (int p = 0; p < DISPLAY_PLANES; p++) {
+    if (!(state.planeMask & (1 << p))) continue;
+    collisions += DrawSprite<Quirks>(state.planes[p], x, y, address, rows, width);
+    address += rows * width / 8;
+  }
+  state.V[0xF] = Quirks::collisionRows && state.hires ? collisions : collisions > 0;
+  // VIP cost grows with height, and sprites that straddle a byte boundary take extra shifts
+  cycles += height * (x % 8 ? VIP_ROW_UNALIGNED_CYCLES : VIP_ROW_ALIGNED_CYCLES);
+  // Waiting for vertical blank before drawing means nothing else runs this frame: in VIP timing
+  // the cycle counter skips to the next frame, otherwise the batch stops until the timer tick
+  if constexpr (Quirks::displayWait) {
+    if (vipTiming)
+      cycles = (cycles / VIP_CYCLES_PER_FRAME + 1) * VIP_CYCLES_PER_FRAME;
+    else
+      waitingForVblank = true;
+  }
+  state.pc += 2;
+  if (!logging) return;
+  entry << Utilities::FormatHex(4, state.opcode) << " DRW Vx, Vy, n |\tDrawing at (" << int(x) << ", " << int(y) << "), height = " << rows << "; V[0xF] = " << int(state.V[0xF]);
+  Log();
 }
 
 void Chip8::opExxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  Byte y = (opcode & 0x00F0) >> 4;
-  switch (opcode & 0x00FF) {
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  bool skip = false;
+  switch (state.opcode & 0x00FF) {
     // 0xEx9E - Skip next instruction if the key value of V[x] is pressed
     case 0x009E:
-      entry << Utilities::FormatHex(4, opcode) << " SKP Vx        |\t" << Utilities::FormatHex(1, int(V[x])) << " pressed? ";
-      if (key[V[x]]) {
-        pc += 2;
-        entry << "Yes, skipping";
-      } else {
-        entry << "No, not skipping";
-      }
-      pc += 2;
+      skip = state.key[state.V[x]];
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SKP Vx        |\t" << Utilities::FormatHex(1, int(state.V[x])) << " pressed? " << (skip ? "Yes, skipping" : "No, not skipping");
       break;
     // 0xExA1 - Skip next instruction if the key value of V[x] is NOT pressed
     case 0x00A1:
-      entry << Utilities::FormatHex(4, opcode) << " SKNP Vx       |\t" << Utilities::FormatHex(1, int(V[x])) << " pressed? ";
-      if (!key[V[x]]) {
-        pc += 2;
-        entry << "No, skipping";
-      } else {
-        entry << "Yes, not skipping";
-      }
-      pc += 2;
+      skip = !state.key[state.V[x]];
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " SKNP Vx       |\t" << Utilities::FormatHex(1, int(state.V[x])) << " pressed? " << (skip ? "No, skipping" : "Yes, not skipping");
       break;
   }
-  screen->PushToLog(entry.str());
+  state.pc += skip ? SkipSize() : 2;
+  cycles += skip * VIP_SKIP_CYCLES;
+  if (logging) Log();
 }
 
+template <typename Quirks>
 void Chip8::opFxxx() {
-  std::stringstream entry;
-  Byte x = (opcode & 0x0F00) >> 8;
-  Byte y = (opcode & 0x00F0) >> 4;
-  switch (opcode & 0x00FF) {
+  Byte x = (state.opcode & 0x0F00) >> 8;
+  switch (state.opcode & 0x00FF) {
+    // 0xF000 nnnn - Load the 16-bit address nnnn into I (XO-CHIP)
+    case 0x0000:
+      if (!xoChip || x != 0) break;
+      state.I = (memory[(state.pc + 2) % MEMORY] << 8) | memory[(state.pc + 3) % MEMORY];
+      Heat(HEAT_EXECUTE, state.pc + 2);
+      Heat(HEAT_EXECUTE, state.pc + 3);
+      state.pc += 4;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD I, nnnn    |\tI = " << Utilities::FormatHex(4, state.I);
+      break;
+    // 0xF002 - Load the 16-byte audio pattern from memory[I] onwards (XO-CHIP)
+    case 0x0002:
+      if (!xoChip || x != 0) break;
+      for (int i = 0; i < PATTERN_BYTES; i++) {
+        audioPattern[i] = memory[(state.I + i) & AddressMask()];
+        Heat(HEAT_READ, state.I + i);
+      }
+      buzzer->QueuePattern(SoundClock(), audioPattern);
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " AUDIO         |\tLoaded pattern from " << Utilities::FormatHex(4, state.I);
+      break;
+    // 0xFn01 - Select the drawing planes in bitmask n (XO-CHIP)
+    case 0x0001:
+      if (!xoChip) break;
+      state.planeMask = x;
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " PLANE n       |\tSelected planes " << Utilities::FormatHex(1, int(x));
+      break;
     // 0xFx07 - Set V[x] = delayTimer
     case 0x0007:
-      V[x] = delayTimer;
-      pc += 2;
-      entry << Utilities::FormatHex(4, opcode) << " LD Vx, DT     |\tSetting V[" << Utilities::FormatHex(1, int(x)) << "] = " << int(delayTimer);
+      state.V[x] = state.delayTimer;
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD Vx, DT     |\tSetting V[" << Utilities::FormatHex(1, int(x)) << "] = " << int(state.delayTimer);
       break;
     // 0xFx0A - Wait for input and store the key value in V[x]
     case 0x000A:
-      entry << Utilities::FormatHex(4, opcode) << " LD Vx, K      |\tWating for input... ";
-      if (keyPressed < 0) 
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD Vx, K      |\t";
+      state.pc += 2;
+      if (keyPressed < 0) {
+        // Halt until a key arrives instead of re-executing this instruction
+        waitingForKey = true;
+        waitRegister = x;
+        if (logging) entry << "Waiting for input...";
         break;
-      V[x] = keyPressed;
-      entry << "Key " << Utilities::FormatHex(1, V[x]) << " pressed";
-      pc += 2;
+      }
+      state.V[x] = keyPressed;
+      if (logging) entry << "Key " << Utilities::FormatHex(1, state.V[x]) << " pressed";
       break;
     // 0xFx15 - Set delayTimer = V[x]
     case 0x0015:
-      delayTimer = V[x];
-      pc += 2;
-      entry << Utilities::FormatHex(4, opcode) << " LD DT, Vx     |\tSetting Delay Timer = " << int(V[x]);
+      state.delayTimer = state.V[x];
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD DT, Vx     |\tSetting Delay Timer = " << int(state.V[x]);
       break;
     // 0xFx18 - Set soundTimer = V[x]
     case 0x0018:
-      soundTimer = V[x];
-      pc += 2;
-      entry << Utilities::FormatHex(4, opcode) << " LD ST, Vx     |\tSetting Sound Timer = " << int(V[x]);
+      state.soundTimer = state.V[x];
+      UpdateSound();
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD ST, Vx     |\tSetting Sound Timer = " << int(state.V[x]);
       break;
     // 0xFx1E - Set I = I + V[x]
     case 0x001E:
-      I += V[x];
-      pc += 2;
-      entry << Utilities::FormatHex(4, opcode) << " ADD I, Vx     |\tI + V[" << Utilities::FormatHex(1, int(x)) << "] = " << Utilities::FormatHex(3, I);
+      state.I = (state.I + state.V[x]) & AddressMask();
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " ADD I, Vx     |\tI + V[" << Utilities::FormatHex(1, int(x)) << "] = " << Utilities::FormatHex(3, state.I);
       break;
     // 0xFx29 - Set I equal to the memory address of the font-sprite for the value in V[x]
     case 0x0029:
-      I = V[x] * 5;
-      pc += 2;
-      entry << Utilities::FormatHex(4, opcode) << " LD F, Vx      |\t";
+      state.I = state.V[x] * 5;
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD F, Vx      |\t";
+      break;
+    // 0xFx30 - Set I to the SUPER-CHIP big font sprite for the digit in V[x]
+    case 0x0030:
+      if (!superChip) break;
+      state.I = BIG_FONT_ADDRESS + (state.V[x] & 0x0F) * 10;
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD HF, Vx     |\tI = " << Utilities::FormatHex(3, state.I);
+      break;
+    // 0xFx3A - Set the audio pattern playback rate to 4000 * 2^((V[x] - 64) / 48) bits per second (XO-CHIP)
+    case 0x003A:
+      if (!xoChip) break;
+      audioPitch = state.V[x];
+      buzzer->QueuePitch(SoundClock(), audioPitch);
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " PITCH Vx      |\tPitch = " << int(audioPitch);
       break;
     // 0xFx33 - Store BCD representation of V[x] at memory locations I, I + 1, I + 2
     case 0x0033:
-      memory[I] = V[x] / 100;
-      memory[I + 1] = (V[x] % 100) / 10;
-      memory[I + 2] = V[x] % 10;
-      entry << Utilities::FormatHex(4, opcode) << " LD B, Vx      |\t";
-      entry << "memory[" << Utilities::FormatHex(3, I) << "] = "     << int(memory[I])     << "; ";
-      entry << "memory[" << Utilities::FormatHex(3, I + 1) << "] = " << int(memory[I + 1]) << "; ";
-      entry << "memory[" << Utilities::FormatHex(3, I + 2) << "] = " << int(memory[I + 2]) << "; ";
-      pc += 2;
+      memory.Write(state.I & AddressMask(), state.V[x] / 100);
+      memory.Write((state.I + 1) & AddressMask(), (state.V[x] % 100) / 10);
+      memory.Write((state.I + 2) & AddressMask(), state.V[x] % 10);
+      Heat(HEAT_WRITE, state.I);
+      Heat(HEAT_WRITE, state.I + 1);
+      Heat(HEAT_WRITE, state.I + 2);
+      state.pc += 2;
+      if (!logging) break;
+      entry << Utilities::FormatHex(4, state.opcode) << " LD B, Vx      |\t";
+      entry << "memory[" << Utilities::FormatHex(3, state.I) << "] = "     << int(memory[state.I])     << "; ";
+      entry << "memory[" << Utilities::FormatHex(3, state.I + 1) << "] = " << int(memory[(state.I + 1) & AddressMask()]) << "; ";
+      entry << "memory[" << Utilities::FormatHex(3, state.I + 2) << "] = " << int(memory[(state.I + 2) & AddressMask()]) << "; ";
       break;
     // 0xFx55 - Store values from registers V[0] to V[x] into memory[I] onwards
     case 0x0055:
-      entry << Utilities::FormatHex(4, opcode) << " LD [I], Vx    |\t";
-      for (int i = 0; i <= x && I + i < MEMORY; i++) {
-        memory[I + i] = V[i]; 
-        entry << "memory[" << Utilities::FormatHex(3, I + i) << "] = " << int(V[i]) << "; ";
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD [I], Vx    |\t";
+      cycles += (x + 1) * VIP_REGISTER_CYCLES;
+      for (int i = 0; i <= x && state.I + i <= AddressMask(); i++) {
+        memory.Write(state.I + i, state.V[i]);
+        Heat(HEAT_WRITE, state.I + i);
+        if (logging) entry << "memory[" << Utilities::FormatHex(3, state.I + i) << "] = " << int(state.V[i]) << "; ";
       }
-      pc += 2;
+      AdvanceI<Quirks>(x);
+      state.pc += 2;
       break;
     // 0xFx65 - Store values starting from memory[I] into registers V[0] to V[x]
     case 0x0065:
-      entry << Utilities::FormatHex(4, opcode) << " LD Vx, [I]    |\t";
-      for (int i = 0; i <= x && I + i < MEMORY; i++) {
-        V[i] = memory[I + i]; 
-        entry << "V[" << Utilities::FormatHex(1, i) << "] = " << int(V[i]) << "; ";
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD Vx, [I]    |\t";
+      cycles += (x + 1) * VIP_REGISTER_CYCLES;
+      for (int i = 0; i <= x && state.I + i <= AddressMask(); i++) {
+        state.V[i] = memory[state.I + i]; 
+        Heat(HEAT_READ, state.I + i);
+        if (logging) entry << "V[" << Utilities::FormatHex(1, i) << "] = " << int(state.V[i]) << "; ";
       }
-      pc += 2;
+      AdvanceI<Quirks>(x);
+      state.pc += 2;
+      break;
+    // 0xFx75 - Save V[0] to V[x] in the RPL user flags (kept across ROM loads, as on the HP48)
+    case 0x0075:
+      if (!superChip) break;
+      std::copy(state.V, state.V + x + 1, rplFlags);
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD R, Vx      |\tSaved V[0] to V[" << Utilities::FormatHex(1, int(x)) << "]";
+      break;
+    // 0xFx85 - Restore V[0] to V[x] from the RPL user flags
+    case 0x0085:
+      if (!superChip) break;
+      std::copy(rplFlags, rplFlags + x + 1, state.V);
+      state.pc += 2;
+      if (logging) entry << Utilities::FormatHex(4, state.opcode) << " LD Vx, R      |\tRestored V[0] to V[" << Utilities::FormatHex(1, int(x)) << "]";
       break;
   }
-  screen->PushToLog(entry.str());
+  if (logging) Log();
 }
 
 Chip8::~Chip8() {
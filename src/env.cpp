@@ -0,0 +1,210 @@
+#include "env.h"
+#include "chip8.h"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+VectorEnv::VectorEnv(const char *romPath, unsigned count, EnvOptions options, uint64_t *observations)
+  : count(count), options(std::move(options)), held(count, 0), random(count) {
+  shared = nullptr;
+  sharedBytes = 0;
+  actions = nullptr;
+  rewards = nullptr;
+  done = nullptr;
+  generation = 0;
+  pending = 0;
+  stopping = false;
+  for (unsigned env = 0; env < count; env++) {
+    random[env] = 0x9E3779B9u * (env + 1);
+  }
+
+  // One headless machine loads the ROM; every lane starts as a copy of it, sharing its pages
+  machine = std::make_unique<Chip8>(this->options.cyclesPerSecond, 0, true);
+  if (!count || this->options.cyclesPerSecond == UNLIMITED_CYCLES || !machine->LoadROM(romPath)) {
+    printf("Failed to create environments for %s\n", romPath);
+    return;
+  }
+  // Refuse ROMs whose lanes would halt (and report done) from the start: ones loaded into a state
+  // lanes can't hold, or that reach a SUPER-CHIP, XO-CHIP or 0nnn instruction in their first second
+  LaneCore probe(this->options.cyclesPerSecond);
+  probe.Load(*machine);
+  for (int frame = 0; frame < ENV_PROBE_FRAMES && probe.Runnable() && !(probe.Halted() & 1); frame++) {
+    probe.RunFrame();
+  }
+  if (!probe.Runnable() || (probe.Halted() & 1)) {
+    printf("%s cannot run on lane cores (it needs SUPER-CHIP, XO-CHIP, MegaChip or machine code)\n", romPath);
+    return;
+  }
+  for (unsigned first = 0; first < count; first += LANES) {
+    uint64_t *rows = observations ? observations + std::size_t(first) * LANE_HEIGHT : nullptr;
+    cores.push_back(std::make_unique<LaneCore>(this->options.cyclesPerSecond, rows));
+    cores.back()->Load(*machine);
+  }
+  Reset();
+
+  unsigned threads = this->options.threads ? this->options.threads : std::thread::hardware_concurrency();
+  threads = std::clamp<unsigned>(threads, 1, cores.size());
+  for (unsigned worker = 1; worker < threads; worker++) {
+    workers.emplace_back(&VectorEnv::WorkerLoop, this, worker);
+  }
+}
+
+VectorEnv::~VectorEnv() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers) worker.join();
+  Unshare();
+}
+
+// Observation buffer size for `count` environments, rounded up to whole lane cores
+std::size_t VectorEnv::ObservationBytes(unsigned count) {
+  return std::size_t((count + LANES - 1) / LANES) * LANES * LANE_HEIGHT * sizeof(uint64_t);
+}
+
+// Restarts every environment. Lanes past the last environment stay halted.
+void VectorEnv::Reset() {
+  for (unsigned group = 0; group < cores.size(); group++) {
+    unsigned lanes = std::min<unsigned>(LANES, count - group * LANES);
+    LaneMask used = lanes == LANES ? ALL_LANES : (LaneMask(1) << lanes) - 1;
+    cores[group]->Restart(used);
+    cores[group]->Halt(~used);
+  }
+  std::fill(held.begin(), held.end(), 0);
+}
+
+void VectorEnv::Reset(unsigned env) {
+  cores[env / LANES]->Restart(LaneMask(1) << (env % LANES));
+  held[env] = 0;
+}
+
+// Runs frameSkip frames in every environment with actions[env] held, summing rewards[env] and
+// setting done[env]. Observations are in the buffer when this returns.
+void VectorEnv::Step(const uint16_t *actions, float *rewards, bool *done) {
+  this->actions = actions;
+  this->rewards = rewards;
+  this->done = done;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    pending = workers.size();
+  }
+  wake.notify_all();
+  StepShare(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this] { return pending == 0; });
+}
+
+void VectorEnv::WorkerLoop(unsigned worker) {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [&] { return stopping || generation != seen; });
+    if (stopping) return;
+    seen = generation;
+    lock.unlock();
+    StepShare(worker);
+    lock.lock();
+    if (--pending == 0) finished.notify_one();
+  }
+}
+
+// Lane cores are dealt out round-robin, one share per thread
+void VectorEnv::StepShare(unsigned worker) {
+  for (unsigned group = worker; group < cores.size(); group += workers.size() + 1) {
+    StepCore(group);
+  }
+}
+
+void VectorEnv::StepCore(unsigned group) {
+  LaneCore &core = *cores[group];
+  unsigned first = group * LANES;
+  int lanes = std::min<unsigned>(LANES, count - first);
+  for (int lane = 0; lane < lanes; lane++) {
+    rewards[first + lane] = 0.0f;
+    done[first + lane] = false;
+  }
+  for (unsigned frame = 0; frame < options.frameSkip; frame++) {
+    for (int lane = 0; lane < lanes; lane++) {
+      unsigned env = first + lane;
+      uint16_t keys = actions[env];
+      // Sticky actions: sometimes the previous keys stay down for another frame
+      if (options.stickyActions > 0.0f) {
+        uint32_t &state = random[env];
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if ((state >> 8) * (1.0f / (1 << 24)) < options.stickyActions) keys = held[env];
+      }
+      Press(core, lane, env, keys);
+    }
+    core.RunFrame();
+    for (int lane = 0; lane < lanes; lane++) {
+      unsigned env = first + lane;
+      if (options.reward) rewards[env] += options.reward(core, lane, env);
+      done[env] = done[env] || ((core.Halted() >> lane) & 1) || (options.done && options.done(core, lane, env));
+    }
+  }
+}
+
+// Sends a lane the key changes between what it holds and `keys`
+void VectorEnv::Press(LaneCore &core, int lane, unsigned env, uint16_t keys) {
+  uint16_t changed = keys ^ held[env];
+  for (int k = 0; k < 16; k++) {
+    if ((changed >> k) & 1) core.SetKey(lane, k, (keys >> k) & 1);
+  }
+  held[env] = keys;
+}
+
+void VectorEnv::SetObservations(uint64_t *buffer) {
+  for (unsigned group = 0; group < cores.size(); group++) {
+    cores[group]->SetDisplay(buffer ? buffer + std::size_t(group) * LANES * LANE_HEIGHT : nullptr);
+  }
+}
+
+// Moves the observations into the POSIX shared-memory object `name` (created or replaced), which
+// other processes can map read-only to see every frame as it is drawn
+bool VectorEnv::ShareObservations(const char *name) {
+  std::size_t bytes = ObservationBytes(count);
+  int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+  if (fd < 0) {
+    perror("Failed to create shared observations");
+    return false;
+  }
+  if (ftruncate(fd, bytes) < 0) {
+    perror("Failed to size shared observations");
+    close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  void *mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    perror("Failed to map shared observations");
+    shm_unlink(name);
+    return false;
+  }
+
+  SetObservations((uint64_t *)mapping);
+  if (shared) {
+    munmap(shared, sharedBytes);
+    if (sharedName != name) shm_unlink(sharedName.c_str());
+  }
+  shared = (uint64_t *)mapping;
+  sharedBytes = bytes;
+  sharedName = name;
+  printf("Sharing observations in %s (%zu bytes)\n", name, bytes);
+  return true;
+}
+
+void VectorEnv::Unshare() {
+  if (!shared) return;
+  SetObservations(nullptr);
+  munmap(shared, sharedBytes);
+  shm_unlink(sharedName.c_str());
+  shared = nullptr;
+}
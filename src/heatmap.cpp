@@ -0,0 +1,47 @@
+#include "heatmap.h"
+#include <algorithm>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+Heatmap::Heatmap() {
+  Clear();
+}
+
+void Heatmap::Clear() {
+  std::fill(&heat[0][0], &heat[0][0] + HEAT_KINDS * HEATMAP_ADDRESSES, 0.0f);
+}
+
+// Multiplies every counter by HEATMAP_DECAY, four addresses at a time when SSE is available
+void Heatmap::Decay() {
+  float *counter = &heat[0][0];
+  int count = HEAT_KINDS * HEATMAP_ADDRESSES;
+#ifdef __SSE__
+  __m128 decay = _mm_set1_ps(HEATMAP_DECAY);
+  for (int i = 0; i < count; i += 4) {
+    _mm_store_ps(counter + i, _mm_mul_ps(_mm_load_ps(counter + i), decay));
+  }
+#else
+  for (int i = 0; i < count; i++) {
+    counter[i] *= HEATMAP_DECAY;
+  }
+#endif
+}
+
+// Maps a counter onto [0, 1) with a soft knee so hot loops don't wash out the rest of memory
+// (untracked addresses read as cold)
+float Heatmap::Intensity(int kind, unsigned address) const {
+  if (address >= HEATMAP_ADDRESSES) return 0.0f;
+  float value = heat[kind][address];
+  return value / (value + HEATMAP_KNEE);
+}
+
+// Writes a HEATMAP_SIZE x HEATMAP_SIZE image: red = writes, green = reads, blue = execution
+void Heatmap::FillRGBA(unsigned char *rgba) const {
+  for (unsigned i = 0; i < HEATMAP_ADDRESSES; i++) {
+    rgba[i * 4]     = Intensity(HEAT_WRITE, i) * 255;
+    rgba[i * 4 + 1] = Intensity(HEAT_READ, i) * 255;
+    rgba[i * 4 + 2] = Intensity(HEAT_EXECUTE, i) * 255;
+    rgba[i * 4 + 3] = 255;
+  }
+}
@@ -0,0 +1,656 @@
+#include "lanes.h"
+#include "chip8.h"
+#include <algorithm>
+#include <bit>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static_assert(LANES % 16 == 0, "Lanes are processed 16 at a time");
+
+// Sixteen lanes of a byte register: one SSE2 register, or a plain array without SSE2
+#ifdef __SSE2__
+typedef __m128i Lanes16;
+#else
+typedef struct { Byte b[16]; } Lanes16;
+#endif
+
+#ifdef __SSE2__
+#define LANE_OP(name, intrinsic, expression) \
+  static inline Lanes16 name(Lanes16 a, Lanes16 b) { return intrinsic(a, b); }
+#else
+#define LANE_OP(name, intrinsic, expression) \
+  static inline Lanes16 name(Lanes16 a, Lanes16 b) { Lanes16 r; for (int i = 0; i < 16; i++) r.b[i] = (Byte)(expression); return r; }
+#endif
+
+LANE_OP(Add, _mm_add_epi8, a.b[i] + b.b[i])
+LANE_OP(Sub, _mm_sub_epi8, a.b[i] - b.b[i])
+LANE_OP(And, _mm_and_si128, a.b[i] & b.b[i])
+LANE_OP(AndNot, _mm_andnot_si128, ~a.b[i] & b.b[i])
+LANE_OP(Or, _mm_or_si128, a.b[i] | b.b[i])
+LANE_OP(Xor, _mm_xor_si128, a.b[i] ^ b.b[i])
+LANE_OP(Equal, _mm_cmpeq_epi8, a.b[i] == b.b[i] ? 0xFF : 0)
+LANE_OP(SubSaturate, _mm_subs_epu8, a.b[i] > b.b[i] ? a.b[i] - b.b[i] : 0)
+
+static inline Lanes16 LoadRow(const Byte *lanes) {
+#ifdef __SSE2__
+  return _mm_load_si128((const __m128i *)lanes);
+#else
+  Lanes16 r;
+  std::copy(lanes, lanes + 16, r.b);
+  return r;
+#endif
+}
+
+static inline void StoreRow(Byte *lanes, Lanes16 value) {
+#ifdef __SSE2__
+  _mm_store_si128((__m128i *)lanes, value);
+#else
+  std::copy(value.b, value.b + 16, lanes);
+#endif
+}
+
+static inline Lanes16 Splat(Byte value) {
+#ifdef __SSE2__
+  return _mm_set1_epi8(value);
+#else
+  Lanes16 r;
+  std::fill(r.b, r.b + 16, value);
+  return r;
+#endif
+}
+
+// 0xFF where a >= b (unsigned)
+static inline Lanes16 AtLeast(Lanes16 a, Lanes16 b) {
+#ifdef __SSE2__
+  return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+#else
+  Lanes16 r;
+  for (int i = 0; i < 16; i++) r.b[i] = a.b[i] >= b.b[i] ? 0xFF : 0;
+  return r;
+#endif
+}
+
+static inline Lanes16 ShiftRight(Lanes16 a) {
+#ifdef __SSE2__
+  return _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F));
+#else
+  Lanes16 r;
+  for (int i = 0; i < 16; i++) r.b[i] = a.b[i] >> 1;
+  return r;
+#endif
+}
+
+static inline Lanes16 HighBit(Lanes16 a) {
+#ifdef __SSE2__
+  return _mm_and_si128(_mm_srli_epi16(a, 7), _mm_set1_epi8(1));
+#else
+  Lanes16 r;
+  for (int i = 0; i < 16; i++) r.b[i] = a.b[i] >> 7;
+  return r;
+#endif
+}
+
+// Takes `a` in the lanes where `select` is 0xFF and `b` elsewhere
+static inline Lanes16 Select(Lanes16 select, Lanes16 a, Lanes16 b) {
+  return Or(And(select, a), AndNot(select, b));
+}
+
+// 0xFF in each lane whose bit is set in the low 16 bits of `lanes`
+static inline Lanes16 Expand(LaneMask lanes) {
+#ifdef __SSE2__
+  const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  __m128i spread = _mm_set_epi64x(0x0101010101010101ULL * ((lanes >> 8) & 0xFF), 0x0101010101010101ULL * (lanes & 0xFF));
+  return _mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits);
+#else
+  Lanes16 r;
+  for (int i = 0; i < 16; i++) r.b[i] = (lanes >> i) & 1 ? 0xFF : 0;
+  return r;
+#endif
+}
+
+// One bit per lane from the top bit of each byte, the inverse of Expand
+static inline LaneMask Bits(Lanes16 a) {
+#ifdef __SSE2__
+  return _mm_movemask_epi8(a);
+#else
+  LaneMask r = 0;
+  for (int i = 0; i < 16; i++) r |= LaneMask(a.b[i] >> 7) << i;
+  return r;
+#endif
+}
+
+// Lanes whose word equals `value`
+static LaneMask Matching(const Word *words, Word value) {
+  LaneMask lanes = 0;
+#ifdef __SSE2__
+  const __m128i target = _mm_set1_epi16(value);
+  for (int w = 0; w < LANES; w += 16) {
+    __m128i lo = _mm_cmpeq_epi16(_mm_load_si128((const __m128i *)(words + w)), target);
+    __m128i hi = _mm_cmpeq_epi16(_mm_load_si128((const __m128i *)(words + w + 8)), target);
+    lanes |= LaneMask(_mm_movemask_epi8(_mm_packs_epi16(lo, hi))) << w;
+  }
+#else
+  for (int lane = 0; lane < LANES; lane++) lanes |= LaneMask(words[lane] == value) << lane;
+#endif
+  return lanes;
+}
+
+// Writes `row` (16 lanes starting at `first`) back to the selected lanes of a register
+static inline void Merge(Byte *reg, int first, LaneMask lanes, Lanes16 row) {
+  StoreRow(reg + first, Select(Expand(lanes >> first), row, LoadRow(reg + first)));
+}
+
+#define LANE_TABLE(Quirks) {                                                                \
+  &LaneCore::op0xxx, &LaneCore::op1xxx, &LaneCore::op2xxx, &LaneCore::op3xxx,               \
+  &LaneCore::op4xxx, &LaneCore::op5xxx, &LaneCore::op6xxx, &LaneCore::op7xxx,               \
+  &LaneCore::op8xxx<Quirks>, &LaneCore::op9xxx, &LaneCore::opAxxx, &LaneCore::opBxxx<Quirks>, \
+  &LaneCore::opCxxx, &LaneCore::opDxxx<Quirks>, &LaneCore::opExxx, &LaneCore::opFxxx<Quirks>, \
+}
+
+const LaneCore::Handler LaneCore::handlerTables[QUIRK_PROFILES][16] = {
+  LANE_TABLE(Chip8Quirks),
+  LANE_TABLE(VipQuirks),
+  LANE_TABLE(Chip48Quirks),
+  LANE_TABLE(SchipQuirks),
+  LANE_TABLE(XoChipQuirks),
+};
+
+LaneCore::LaneCore(uint64_t cyclesPerSecond, uint64_t *display)
+  : ownedDisplay(display ? nullptr : std::make_unique<uint64_t[]>(LANES * LANE_HEIGHT)),
+    display((uint64_t (*)[LANE_HEIGHT])(display ? display : ownedDisplay.get())),
+    memory(LANES, PagedMemory(MEMORY)), initial(std::make_unique<CoreState>()), initialMemory(MEMORY) {
+  this->cyclesPerSecond = cyclesPerSecond;
+  quirkProfile = QUIRKS_CHIP8;
+  handlers = handlerTables[quirkProfile];
+  std::fill(&V[0][0], &V[0][0] + 16 * LANES, 0);
+  std::fill(&stack[0][0], &stack[0][0] + 16 * LANES, 0);
+  std::fill(&this->display[0][0], &this->display[0][0] + LANES * LANE_HEIGHT, 0);
+  std::fill(delayTimer, delayTimer + LANES, 0);
+  std::fill(soundTimer, soundTimer + LANES, 0);
+  std::fill(pc, pc + LANES, PROGRAM_START);
+  std::fill(I, I + LANES, 0);
+  std::fill(opcodes, opcodes + LANES, 0);
+  std::fill(sp, sp + LANES, 0);
+  std::fill(keys, keys + LANES, 0);
+  std::fill(waitRegister, waitRegister + LANES, 0);
+  for (int lane = 0; lane < LANES; lane++) {
+    random[lane] = 0x9E3779B9u * (lane + 1);
+  }
+  waitingForKey = 0;
+  waitingForVblank = 0;
+  halted = 0;
+  runnable = true;
+  cycleRemainder = 0;
+  stepCount = 0;
+  instructions = 0;
+  dispatches = 0;
+}
+
+// Starts every lane as a copy of `machine` (normally one that has just loaded a ROM). Memory is
+// shared copy-on-write, so the lanes only pay for the pages each one writes. Machines the lanes
+// cannot run (hi-res, bitplanes, MegaChip memory) leave every lane halted.
+void LaneCore::Load(Chip8 &machine) {
+  *initial = machine.State();
+  initialMemory = machine.Memory();
+  quirkProfile = machine.QuirkProfile();
+  handlers = handlerTables[quirkProfile];
+  runnable = !initial->hires && initial->planeMask == 1 && initialMemory.Size() == MEMORY;
+  cycleRemainder = 0;
+  stepCount = 0;
+  Restart(ALL_LANES);
+}
+
+// Puts `lanes` back to the loaded machine, e.g. at the end of an episode. The step and timer
+// phase are shared by all lanes and carry on.
+void LaneCore::Restart(LaneMask lanes) {
+  const CoreState &state = *initial;
+  for (LaneMask m = lanes; m; m &= m - 1) {
+    int lane = std::countr_zero(m);
+    for (int r = 0; r < 16; r++) {
+      V[r][lane] = state.V[r];
+      stack[r][lane] = state.stack[r];
+    }
+    pc[lane] = state.pc;
+    I[lane] = state.I;
+    sp[lane] = state.sp;
+    delayTimer[lane] = state.delayTimer;
+    soundTimer[lane] = state.soundTimer;
+    keys[lane] = 0;
+    for (int k = 0; k < 16; k++) keys[lane] |= (state.key[k] != 0) << k;
+    // Lo-res pixels are doubled on the display: keep every other bit of every other row
+    for (int y = 0; y < LANE_HEIGHT; y++) {
+      uint64_t row = 0;
+      for (int x = 0; x < LANE_WIDTH; x++) {
+        row |= uint64_t((state.planes[0][y * 2] >> (DISPLAY_WIDTH - 1 - x * 2)) & 1) << (LANE_WIDTH - 1 - x);
+      }
+      display[lane][y] = row;
+    }
+    memory[lane] = initialMemory;
+  }
+  waitingForKey &= ~lanes;
+  waitingForVblank &= ~lanes;
+  halted = runnable ? halted & ~lanes : halted | lanes;
+}
+
+// Moves the display into `rows` (LANES * LANE_HEIGHT words, e.g. part of a shared observation
+// buffer), so sprites are drawn straight into it; nullptr moves it back into the core
+void LaneCore::SetDisplay(uint64_t *rows) {
+  uint64_t *target = rows;
+  std::unique_ptr<uint64_t[]> owned;
+  if (!target) {
+    if (ownedDisplay) return;
+    owned = std::make_unique<uint64_t[]>(LANES * LANE_HEIGHT);
+    target = owned.get();
+  }
+  std::copy(&display[0][0], &display[0][0] + LANES * LANE_HEIGHT, target);
+  display = (uint64_t (*)[LANE_HEIGHT])target;
+  ownedDisplay = std::move(owned);
+}
+
+// Copies one lane out as a CoreState, e.g. to compare it with a scalar Chip8 or to hand it over
+void LaneCore::Export(int lane, CoreState &state) const {
+  for (int r = 0; r < 16; r++) {
+    state.V[r] = V[r][lane];
+    state.stack[r] = stack[r][lane];
+    state.key[r] = (keys[lane] >> r) & 1;
+  }
+  state.I = I[lane];
+  state.pc = pc[lane];
+  state.opcode = opcodes[lane];
+  state.sp = sp[lane];
+  state.delayTimer = delayTimer[lane];
+  state.soundTimer = soundTimer[lane];
+  state.planeMask = 1;
+  state.hires = false;
+  std::fill(&state.planes[0][0], &state.planes[0][0] + DISPLAY_PLANES * DISPLAY_HEIGHT, 0);
+  for (int y = 0; y < LANE_HEIGHT; y++) {
+    DisplayRow row = 0;
+    for (int x = 0; x < LANE_WIDTH; x++) {
+      if ((display[lane][y] >> (LANE_WIDTH - 1 - x)) & 1) row |= DisplayRow(3) << (DISPLAY_WIDTH - 2 - x * 2);
+    }
+    state.planes[0][y * 2] = state.planes[0][y * 2 + 1] = row;
+  }
+}
+
+// Updates a key in one lane; a press releases that lane from an Fx0A wait
+void LaneCore::SetKey(int lane, Byte k, bool pressed) {
+  LaneMask bit = LaneMask(1) << lane;
+  k &= 0xF;
+  keys[lane] = pressed ? keys[lane] | (1 << k) : keys[lane] & ~(1 << k);
+  if ((waitingForKey & bit) && pressed) {
+    V[waitRegister[lane]][lane] = k;
+    waitingForKey &= ~bit;
+  }
+}
+
+// Runs one frame: STEPS_PER_TIMER_TICK instruction batches, then the 60 Hz timers
+void LaneCore::RunFrame() {
+  for (int i = 0; i < STEPS_PER_TIMER_TICK; i++) {
+    RunStep();
+  }
+}
+
+// One step's share of cyclesPerSecond for every lane, with the same remainder carry, vblank waits
+// and timer tick as Chip8::RunStep
+void LaneCore::RunStep() {
+  bool timerTick = ++stepCount % STEPS_PER_TIMER_TICK == 0;
+  cycleRemainder += cyclesPerSecond;
+  uint64_t budget = cycleRemainder / STEP_FREQUENCY;
+  cycleRemainder %= STEP_FREQUENCY;
+  for (uint64_t i = 0; i < budget; i++) {
+    LaneMask lanes = ~(waitingForKey | waitingForVblank | halted);
+    if (!lanes) break;
+    Execute(lanes);
+  }
+  if (!timerTick) return;
+  waitingForVblank = 0;
+  for (int h = 0; h < LANES; h += 16) {
+    StoreRow(soundTimer + h, SubSaturate(LoadRow(soundTimer + h), Splat(1)));
+    StoreRow(delayTimer + h, SubSaturate(LoadRow(delayTimer + h), Splat(1)));
+  }
+}
+
+// Executes one instruction in each of `lanes`: one dispatch per distinct opcode among them
+void LaneCore::Execute(LaneMask lanes) {
+  for (LaneMask pending = lanes; pending; pending &= pending - 1) {
+    int lane = std::countr_zero(pending);
+    opcodes[lane] = (memory[lane][pc[lane]] << 8) | memory[lane][(pc[lane] + 1) % MEMORY];
+  }
+  instructions += std::popcount(lanes);
+  while (lanes) {
+    Word opcode = opcodes[std::countr_zero(lanes)];
+    LaneMask group = Matching(opcodes, opcode) & lanes;
+    lanes &= ~group;
+    dispatches++;
+    (this->*handlers[opcode >> 12])(group, opcode);
+  }
+}
+
+// Moves pc on by 2 in `lanes`, and by 4 in those of them that also skip the next instruction
+void LaneCore::Advance(LaneMask lanes, LaneMask skip) {
+  skip &= lanes;
+#ifdef __SSE2__
+  const __m128i bits = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m128i two = _mm_set1_epi16(2);
+  for (int w = 0; w < LANES; w += 8) {
+    __m128i stepping = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((lanes >> w) & 0xFF), bits), bits);
+    __m128i skipping = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16((skip >> w) & 0xFF), bits), bits);
+    __m128i step = _mm_add_epi16(_mm_and_si128(stepping, two), _mm_and_si128(skipping, two));
+    _mm_store_si128((__m128i *)(pc + w), _mm_add_epi16(_mm_load_si128((const __m128i *)(pc + w)), step));
+  }
+#else
+  for (; lanes; lanes &= lanes - 1) {
+    int lane = std::countr_zero(lanes);
+    pc[lane] += (skip >> lane) & 1 ? 4 : 2;
+  }
+#endif
+}
+
+void LaneCore::SetWords(Word *target, Word value, LaneMask lanes) {
+  for (; lanes; lanes &= lanes - 1) {
+    target[std::countr_zero(lanes)] = value;
+  }
+}
+
+void LaneCore::op0xxx(LaneMask lanes, Word opcode) {
+  switch (opcode) {
+    // 0x00E0 - Clear Screen
+    case 0x00E0:
+      for (LaneMask m = lanes; m; m &= m - 1) {
+        std::fill(display[std::countr_zero(m)], display[std::countr_zero(m)] + LANE_HEIGHT, 0);
+      }
+      Advance(lanes, 0);
+      break;
+    // 0x00EE - Return (an underflowing return stays put, as in the scalar core)
+    case 0x00EE:
+      for (; lanes; lanes &= lanes - 1) {
+        int lane = std::countr_zero(lanes);
+        if (sp[lane] == 0) continue;
+        if (sp[lane] < 16) stack[sp[lane]][lane] = 0;
+        pc[lane] = stack[--sp[lane]][lane] + 2;
+      }
+      break;
+    // 0x0nnn and the SUPER-CHIP/XO-CHIP display instructions need a Chip8
+    default:
+      halted |= lanes;
+      break;
+  }
+}
+
+// 0x1nnn - Jump to address nnn
+void LaneCore::op1xxx(LaneMask lanes, Word opcode) {
+  SetWords(pc, opcode & 0x0FFF, lanes);
+}
+
+// 0x2nnn - Call function at nnn
+void LaneCore::op2xxx(LaneMask lanes, Word opcode) {
+  for (; lanes; lanes &= lanes - 1) {
+    int lane = std::countr_zero(lanes);
+    if (sp[lane] >= 16) {
+      pc[lane] += 2;
+      continue;
+    }
+    stack[sp[lane]++][lane] = pc[lane];
+    pc[lane] = opcode & 0x0FFF;
+  }
+}
+
+// 0x3xbb - Skip next instruction if V[x] == bb
+void LaneCore::op3xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  LaneMask skip = 0;
+  for (int h = 0; h < LANES; h += 16) {
+    skip |= Bits(Equal(LoadRow(V[x] + h), Splat(opcode & 0x00FF))) << h;
+  }
+  Advance(lanes, skip);
+}
+
+// 0x4xbb - Skip next instruction if V[x] != bb
+void LaneCore::op4xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  LaneMask skip = 0;
+  for (int h = 0; h < LANES; h += 16) {
+    skip |= Bits(Equal(LoadRow(V[x] + h), Splat(opcode & 0x00FF))) << h;
+  }
+  Advance(lanes, ~skip);
+}
+
+// 0x5xy0 - Skip next instruction if V[x] == V[y]
+void LaneCore::op5xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  Byte y = (opcode & 0x00F0) >> 4;
+  if (opcode & 0x000F) {
+    halted |= lanes;
+    return;
+  }
+  LaneMask skip = 0;
+  for (int h = 0; h < LANES; h += 16) {
+    skip |= Bits(Equal(LoadRow(V[x] + h), LoadRow(V[y] + h))) << h;
+  }
+  Advance(lanes, skip);
+}
+
+// 0x6xbb - Load bb into V[x]
+void LaneCore::op6xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  for (int h = 0; h < LANES; h += 16) {
+    Merge(V[x], h, lanes, Splat(opcode & 0x00FF));
+  }
+  Advance(lanes, 0);
+}
+
+// 0x7xbb - Increment V[x] by bb
+void LaneCore::op7xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  for (int h = 0; h < LANES; h += 16) {
+    Merge(V[x], h, lanes, Add(LoadRow(V[x] + h), Splat(opcode & 0x00FF)));
+  }
+  Advance(lanes, 0);
+}
+
+// 0x8xyn - Register arithmetic. Flags are worked out from the operands and written last, so
+// V[F] as an operand still works.
+template <typename Quirks>
+void LaneCore::op8xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  Byte y = (opcode & 0x00F0) >> 4;
+  const Lanes16 one = Splat(1);
+  for (int h = 0; h < LANES; h += 16) {
+    Lanes16 vx = LoadRow(V[x] + h), vy = LoadRow(V[y] + h);
+    Lanes16 source = Quirks::shiftUsesVy ? vy : vx;
+    Lanes16 result = vx, flag = Splat(0);
+    bool setsFlag = true;
+    switch (opcode & 0x000F) {
+      case 0x0: result = vy; setsFlag = false; break;
+      case 0x1: result = Or(vx, vy); setsFlag = Quirks::logicResetsVF; break;
+      case 0x2: result = And(vx, vy); setsFlag = Quirks::logicResetsVF; break;
+      case 0x3: result = Xor(vx, vy); setsFlag = Quirks::logicResetsVF; break;
+      // Carry when V[x] > 255 - V[y]
+      case 0x4: result = Add(vx, vy); flag = AndNot(AtLeast(Xor(vy, Splat(0xFF)), vx), one); break;
+      case 0x5: result = Sub(vx, vy); flag = And(AtLeast(vx, vy), one); break;
+      case 0x6: result = ShiftRight(source); flag = And(source, one); break;
+      case 0x7: result = Sub(vy, vx); flag = And(AtLeast(vy, vx), one); break;
+      case 0xE: result = Add(source, source); flag = HighBit(source); break;
+      default: setsFlag = false; break;
+    }
+    Merge(V[x], h, lanes, result);
+    if (setsFlag) Merge(V[0xF], h, lanes, flag);
+  }
+  Advance(lanes, 0);
+}
+
+// 0x9xy0 - Skip next instruction if V[x] != V[y]
+void LaneCore::op9xxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  Byte y = (opcode & 0x00F0) >> 4;
+  LaneMask skip = 0;
+  for (int h = 0; h < LANES; h += 16) {
+    skip |= Bits(Equal(LoadRow(V[x] + h), LoadRow(V[y] + h))) << h;
+  }
+  Advance(lanes, ~skip);
+}
+
+// 0xAnnn - Load nnn into I
+void LaneCore::opAxxx(LaneMask lanes, Word opcode) {
+  SetWords(I, opcode & 0x0FFF, lanes);
+  Advance(lanes, 0);
+}
+
+// 0xBnnn - Jump to address nnn + V[0] (0xBxnn - xnn + V[x] on CHIP-48 and SUPER-CHIP)
+template <typename Quirks>
+void LaneCore::opBxxx(LaneMask lanes, Word opcode) {
+  Byte x = Quirks::jumpUsesVx ? (opcode & 0x0F00) >> 8 : 0;
+  for (; lanes; lanes &= lanes - 1) {
+    int lane = std::countr_zero(lanes);
+    pc[lane] = (opcode & 0x0FFF) + V[x][lane];
+  }
+}
+
+// 0xCxbb - Set V[x] = random AND bb, from each lane's own xorshift generator
+void LaneCore::opCxxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  for (LaneMask m = lanes; m; m &= m - 1) {
+    int lane = std::countr_zero(m);
+    uint32_t &state = random[lane];
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    V[x][lane] = (state >> 24) & opcode & 0x00FF;
+  }
+  Advance(lanes, 0);
+}
+
+// Lo-res sprite for one lane. Display rows hold column 0 in their top bit, so a sprite row is a
+// shifted byte XORed into one word.
+template <typename Quirks>
+bool LaneCore::DrawSprite(int lane, int x, int y, int height) {
+  bool collided = false;
+  for (int i = 0; i < height; i++) {
+    int row = y + i;
+    if (row >= LANE_HEIGHT) {
+      if constexpr (Quirks::clipSprites) break;
+      row %= LANE_HEIGHT;
+    }
+    uint64_t sprite = uint64_t(memory[lane][(I[lane] + i) & (MEMORY - 1)]) << (LANE_WIDTH - 8);
+    uint64_t mask = sprite >> x;
+    if constexpr (!Quirks::clipSprites) {
+      if (x) mask |= sprite << (LANE_WIDTH - x);
+    }
+    collided |= (display[lane][row] & mask) != 0;
+    display[lane][row] ^= mask;
+  }
+  return collided;
+}
+
+// 0xDxyn - Draw a sprite of n bytes high at (V[x], V[y])
+template <typename Quirks>
+void LaneCore::opDxxx(LaneMask lanes, Word opcode) {
+  Byte height = opcode & 0x000F;
+  // SUPER-CHIP's 16x16 Dxy0 needs a Chip8
+  if (height == 0 && quirkProfile >= QUIRKS_SCHIP) {
+    halted |= lanes;
+    return;
+  }
+  for (LaneMask m = lanes; m; m &= m - 1) {
+    int lane = std::countr_zero(m);
+    Byte x = V[(opcode & 0x0F00) >> 8][lane] % LANE_WIDTH;
+    Byte y = V[(opcode & 0x00F0) >> 4][lane] % LANE_HEIGHT;
+    V[0xF][lane] = DrawSprite<Quirks>(lane, x, y, height);
+  }
+  if constexpr (Quirks::displayWait) waitingForVblank |= lanes;
+  Advance(lanes, 0);
+}
+
+void LaneCore::opExxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  LaneMask pressed = 0;
+  for (LaneMask m = lanes; m; m &= m - 1) {
+    int lane = std::countr_zero(m);
+    pressed |= LaneMask(V[x][lane] < 16 && (keys[lane] >> V[x][lane]) & 1) << lane;
+  }
+  switch (opcode & 0x00FF) {
+    // 0xEx9E - Skip next instruction if the key value of V[x] is pressed
+    case 0x009E: Advance(lanes, pressed); break;
+    // 0xExA1 - Skip next instruction if the key value of V[x] is NOT pressed
+    case 0x00A1: Advance(lanes, ~pressed); break;
+    default: Advance(lanes, 0); break;
+  }
+}
+
+template <typename Quirks>
+void LaneCore::opFxxx(LaneMask lanes, Word opcode) {
+  Byte x = (opcode & 0x0F00) >> 8;
+  switch (opcode & 0x00FF) {
+    // 0xFx07 - Set V[x] = delayTimer
+    case 0x0007:
+      for (int h = 0; h < LANES; h += 16) Merge(V[x], h, lanes, LoadRow(delayTimer + h));
+      break;
+    // 0xFx0A - Wait for input and store the key value in V[x]
+    case 0x000A:
+      for (LaneMask m = lanes; m; m &= m - 1) {
+        int lane = std::countr_zero(m);
+        if (keys[lane]) {
+          V[x][lane] = std::bit_width(keys[lane]) - 1;
+          continue;
+        }
+        waitingForKey |= LaneMask(1) << lane;
+        waitRegister[lane] = x;
+      }
+      break;
+    // 0xFx15 - Set delayTimer = V[x]
+    case 0x0015:
+      for (int h = 0; h < LANES; h += 16) Merge(delayTimer, h, lanes, LoadRow(V[x] + h));
+      break;
+    // 0xFx18 - Set soundTimer = V[x]
+    case 0x0018:
+      for (int h = 0; h < LANES; h += 16) Merge(soundTimer, h, lanes, LoadRow(V[x] + h));
+      break;
+    // 0xFx1E - Set I = I + V[x]
+    case 0x001E:
+      for (LaneMask m = lanes; m; m &= m - 1) {
+        int lane = std::countr_zero(m);
+        I[lane] += V[x][lane];
+      }
+      break;
+    // 0xFx29 - Set I to the font sprite for the value in V[x]
+    case 0x0029:
+      for (LaneMask m = lanes; m; m &= m - 1) {
+        int lane = std::countr_zero(m);
+        I[lane] = V[x][lane] * 5;
+      }
+      break;
+    // 0xFx33 - Store BCD representation of V[x] at I, I + 1, I + 2
+    case 0x0033:
+      for (LaneMask m = lanes; m; m &= m - 1) {
+        int lane = std::countr_zero(m);
+        Byte value = V[x][lane];
+        memory[lane].Write(I[lane], value / 100);
+        memory[lane].Write((Word)(I[lane] + 1), (value % 100) / 10);
+        memory[lane].Write((Word)(I[lane] + 2), value % 10);
+      }
+      break;
+    // 0xFx55 / 0xFx65 - Store V[0] to V[x] at I onwards / load them from there
+    case 0x0055:
+    case 0x0065:
+      for (LaneMask m = lanes; m; m &= m - 1) {
+        int lane = std::countr_zero(m);
+        for (int i = 0; i <= x && I[lane] + i < MEMORY; i++) {
+          if ((opcode & 0x00FF) == 0x0055)
+            memory[lane].Write(I[lane] + i, V[i][lane]);
+          else
+            V[i][lane] = memory[lane][I[lane] + i];
+        }
+        if constexpr (Quirks::memory == MEMORY_INCREMENT)
+          I[lane] += x + 1;
+        else if constexpr (Quirks::memory == MEMORY_INCREMENT_X)
+          I[lane] += x;
+      }
+      break;
+    // Everything else is SUPER-CHIP or XO-CHIP and needs a Chip8
+    default:
+      halted |= lanes;
+      return;
+  }
+  Advance(lanes, 0);
+}
@@ -0,0 +1,165 @@
+#include "megachip.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Pixels are RGBA bytes in memory order, so frames upload as GL_RGBA / GL_UNSIGNED_BYTE
+static_assert(std::endian::native == std::endian::little, "MegaChip pixels are packed for little-endian hosts");
+
+MegaDisplay::MegaDisplay() {
+  Reset();
+}
+
+// Allocates blank buffers, or frees them. Without buffers only the palette and drawing state are
+// kept, and nothing may be drawn or scrolled.
+void MegaDisplay::SetAllocated(bool allocated) {
+  if (allocated == !back.empty()) return;
+  if (allocated) {
+    back.assign(MEGA_PIXELS, 0);
+    front.assign(MEGA_PIXELS, 0);
+    indices.assign(MEGA_PIXELS, 0);
+  } else {
+    std::vector<uint32_t>().swap(back);
+    std::vector<uint32_t>().swap(front);
+    std::vector<uint8_t>().swap(indices);
+  }
+}
+
+void MegaDisplay::Reset() {
+  std::fill(palette, palette + MEGA_PALETTE_SIZE, 0);
+  blendMode = BLEND_NORMAL;
+  collisionIndex = 0;
+  alpha = 0xFF;
+  Clear();
+  Present();
+}
+
+void MegaDisplay::Clear() {
+  std::fill(back.begin(), back.end(), 0);
+  std::fill(indices.begin(), indices.end(), 0);
+}
+
+void MegaDisplay::Present() {
+  std::copy(back.begin(), back.end(), front.begin());
+}
+
+// Moves the back buffer by (dx, dy) pixels, filling the uncovered edge with index 0
+void MegaDisplay::Scroll(int dx, int dy) {
+  if (back.empty()) return;
+  std::vector<uint32_t> pixels(MEGA_PIXELS, 0);
+  std::vector<uint8_t> drawn(MEGA_PIXELS, 0);
+  for (int row = std::max(dy, 0); row < std::min(MEGA_HEIGHT + dy, MEGA_HEIGHT); row++) {
+    int first = std::max(dx, 0), last = std::min(MEGA_WIDTH + dx, MEGA_WIDTH);
+    if (first >= last) break;
+    int source = (row - dy) * MEGA_WIDTH + first - dx;
+    std::copy(&back[source], &back[source] + last - first, &pixels[row * MEGA_WIDTH + first]);
+    std::copy(&indices[source], &indices[source] + last - first, &drawn[row * MEGA_WIDTH + first]);
+  }
+  back.swap(pixels);
+  indices.swap(drawn);
+}
+
+// Fills palette entries 1 to `count` from ARGB quadruples; entry 0 stays transparent
+void MegaDisplay::LoadPalette(const uint8_t *argb, int count) {
+  count = std::min(count, MEGA_PALETTE_SIZE - 1);
+  for (int i = 0; i < count; i++) {
+    const uint8_t *color = argb + i * 4;
+    palette[i + 1] = color[1] | color[2] << 8 | color[3] << 16 | uint32_t(color[0]) << 24;
+  }
+}
+
+// Weights for the fractional blend modes, out of 256
+static int BlendWeight(int mode) {
+  return mode * 64;
+}
+
+static uint32_t BlendPixel(uint32_t source, uint32_t target, int mode) {
+  uint32_t result = 0;
+  if (mode == BLEND_NORMAL) return source;
+  for (int shift = 0; shift < 32; shift += 8) {
+    unsigned s = (source >> shift) & 0xFF, t = (target >> shift) & 0xFF, channel;
+    switch (mode) {
+      case BLEND_ADD:      channel = std::min(s + t, 255u); break;
+      case BLEND_MULTIPLY: channel = (s * t + 255) >> 8; break;
+      default:             channel = (s * BlendWeight(mode) + t * (256 - BlendWeight(mode))) >> 8; break;
+    }
+    result |= channel << shift;
+  }
+  return result;
+}
+
+#ifdef __SSE2__
+// BlendPixel on four pixels at once, channels widened to 16 bits
+static __m128i BlendPixels(__m128i source, __m128i target, int mode) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sourceLo = _mm_unpacklo_epi8(source, zero), sourceHi = _mm_unpackhi_epi8(source, zero);
+  __m128i targetLo = _mm_unpacklo_epi8(target, zero), targetHi = _mm_unpackhi_epi8(target, zero);
+  __m128i lo, hi;
+  switch (mode) {
+    case BLEND_NORMAL:
+      return source;
+    case BLEND_ADD:
+      return _mm_adds_epu8(source, target);
+    case BLEND_MULTIPLY: {
+      __m128i round = _mm_set1_epi16(255);
+      lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(sourceLo, targetLo), round), 8);
+      hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(sourceHi, targetHi), round), 8);
+      break;
+    }
+    default: {
+      __m128i weight = _mm_set1_epi16(BlendWeight(mode)), inverse = _mm_set1_epi16(256 - BlendWeight(mode));
+      lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(sourceLo, weight), _mm_mullo_epi16(targetLo, inverse)), 8);
+      hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(sourceHi, weight), _mm_mullo_epi16(targetHi, inverse)), 8);
+      break;
+    }
+  }
+  return _mm_packus_epi16(lo, hi);
+}
+#endif
+
+// Draws a width x height sprite of palette indices with its top-left corner at (x, y), clipped at
+// the edges. Returns whether any opaque pixel landed on a pixel drawn with the collision index
+// (blank pixels never collide).
+bool MegaDisplay::DrawSprite(int x, int y, const uint8_t *sprite, int width, int height) {
+  bool collided = false;
+  int columns = std::min(width, MEGA_WIDTH - x);
+  int rows = std::min(height, MEGA_HEIGHT - y);
+
+  for (int row = 0; row < rows; row++) {
+    const uint8_t *source = sprite + row * width;
+    uint32_t *target = &back[(y + row) * MEGA_WIDTH + x];
+    uint8_t *drawn = &indices[(y + row) * MEGA_WIDTH + x];
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= columns; i += 4) {
+      uint32_t quad;
+      std::memcpy(&quad, source + i, sizeof(quad));
+      if (quad == 0) continue;
+      // Index 0 lanes keep the target pixel
+      __m128i lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(quad), zero), zero);
+      __m128i transparent = _mm_cmpeq_epi32(lanes, zero);
+      __m128i colors = _mm_set_epi32(palette[source[i + 3]], palette[source[i + 2]], palette[source[i + 1]], palette[source[i]]);
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(target + i));
+      __m128i blended = BlendPixels(colors, pixels, blendMode);
+      pixels = _mm_or_si128(_mm_andnot_si128(transparent, blended), _mm_and_si128(transparent, pixels));
+      _mm_storeu_si128((__m128i *)(target + i), pixels);
+      for (int k = i; k < i + 4; k++) {
+        if (!source[k]) continue;
+        collided |= drawn[k] && drawn[k] == collisionIndex;
+        drawn[k] = source[k];
+      }
+    }
+#endif
+    for (; i < columns; i++) {
+      if (!source[i]) continue;
+      target[i] = BlendPixel(palette[source[i]], target[i], blendMode);
+      collided |= drawn[i] && drawn[i] == collisionIndex;
+      drawn[i] = source[i];
+    }
+  }
+  return collided;
+}
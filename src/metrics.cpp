@@ -0,0 +1,198 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+Metrics::Metrics() {
+  instructions = 0;
+  skippedInstructions = 0;
+  frames = 0;
+  droppedFrames = 0;
+  hostFrames = 0;
+  soundMicroseconds = 0;
+  traceOccupancy = 0;
+  traceCapacity = 0;
+  instructionsPerSecond = 0;
+  frameTimeSum = 0;
+  cpuUsage = 0;
+  refreshRate = 0;
+  presentJitter = 0;
+  for (auto &phase : startup) phase = 0;
+  frameTimeIndex = 0;
+  for (int i = 0; i < METRICS_FRAME_WINDOW; i++) {
+    frameTimes[i] = 0.0f;
+  }
+  windowStart = std::chrono::steady_clock::now();
+  windowInstructions = 0;
+  serving = false;
+}
+
+void Metrics::AddInstructions(unsigned long long count) {
+  unsigned long long total = instructions.fetch_add(count, std::memory_order_relaxed) + count;
+
+  // Recompute effective IPS roughly once per second
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> window = now - windowStart;
+  if (window.count() >= 1.0) {
+    instructionsPerSecond.store((total - windowInstructions) / window.count(), std::memory_order_relaxed);
+    windowInstructions = total;
+    windowStart = now;
+  }
+}
+
+void Metrics::AddHostFrame(float seconds) {
+  unsigned index = frameTimeIndex.fetch_add(1, std::memory_order_relaxed);
+  frameTimes[index % METRICS_FRAME_WINDOW].store(seconds, std::memory_order_relaxed);
+  hostFrames.fetch_add(1, std::memory_order_relaxed);
+  frameTimeSum.store(frameTimeSum.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+}
+
+void Metrics::AddSoundTime(float seconds) {
+  soundMicroseconds.fetch_add(seconds * 1e6f, std::memory_order_relaxed);
+}
+
+void Metrics::SetTraceOccupancy(unsigned occupancy, unsigned capacity) {
+  traceOccupancy.store(occupancy, std::memory_order_relaxed);
+  traceCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+void Metrics::SetPresentation(float refreshRate, float jitter) {
+  this->refreshRate.store(refreshRate, std::memory_order_relaxed);
+  presentJitter.store(jitter, std::memory_order_relaxed);
+}
+
+// Listens on a Unix-domain socket and answers every connection with an HTTP response
+bool Metrics::Serve(const char *socketPath) {
+  sockaddr_un address;
+  int listenFd;
+
+  if (serving) return true;
+  if (std::strlen(socketPath) >= sizeof(address.sun_path)) {
+    printf("Metrics socket path too long: %s\n", socketPath);
+    return false;
+  }
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    perror("Failed to create metrics socket");
+    return false;
+  }
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, socketPath);
+  unlink(socketPath);
+  if (bind(listenFd, (sockaddr *)&address, sizeof(address)) < 0 || listen(listenFd, 4) < 0) {
+    perror("Failed to bind metrics socket");
+    close(listenFd);
+    return false;
+  }
+
+  this->socketPath = socketPath;
+  serving = true;
+  server = std::thread(&Metrics::ServeLoop, this, listenFd);
+  printf("Serving metrics on %s\n", socketPath);
+  return true;
+}
+
+void Metrics::ServeLoop(int listenFd) {
+  pollfd listener = { listenFd, POLLIN, 0 };
+  char request[1024];
+
+  while (serving) {
+    // Wakes periodically so Stop() never waits on a blocking accept
+    if (poll(&listener, 1, METRICS_POLL_MS) <= 0) continue;
+    int client = accept(listenFd, NULL, NULL);
+    if (client < 0) continue;
+    pollfd reader = { client, POLLIN, 0 };
+    if (poll(&reader, 1, METRICS_POLL_MS) > 0)
+      read(client, request, sizeof(request));
+    std::string body = Render();
+    std::stringstream response;
+    response << "HTTP/1.0 200 OK\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << body.size() << "\r\n\r\n"
+             << body;
+    std::string payload = response.str();
+    send(client, payload.data(), payload.size(), MSG_NOSIGNAL);
+    close(client);
+  }
+  close(listenFd);
+}
+
+// Formats all metrics in the Prometheus text exposition format
+std::string Metrics::Render() {
+  std::stringstream body;
+  std::vector<float> samples;
+  unsigned long long hostFrameCount = hostFrames.load(std::memory_order_relaxed);
+  unsigned sampleCount = std::min<unsigned long long>(hostFrameCount, METRICS_FRAME_WINDOW);
+  for (unsigned i = 0; i < sampleCount; i++) {
+    samples.push_back(frameTimes[i].load(std::memory_order_relaxed));
+  }
+  std::sort(samples.begin(), samples.end());
+
+  body << "# HELP chip8_instructions_total Instructions executed.\n"
+       << "# TYPE chip8_instructions_total counter\n"
+       << "chip8_instructions_total " << instructions.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_idle_skipped_instructions_total Instructions credited without running them while in an idle loop.\n"
+       << "# TYPE chip8_idle_skipped_instructions_total counter\n"
+       << "chip8_idle_skipped_instructions_total " << skippedInstructions.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_frames_total Emulated frames.\n"
+       << "# TYPE chip8_frames_total counter\n"
+       << "chip8_frames_total " << frames.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_dropped_frames_total Emulated frames whose deadline was missed.\n"
+       << "# TYPE chip8_dropped_frames_total counter\n"
+       << "chip8_dropped_frames_total " << droppedFrames.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_instructions_per_second Effective instructions per second.\n"
+       << "# TYPE chip8_instructions_per_second gauge\n"
+       << "chip8_instructions_per_second " << instructionsPerSecond.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_sound_seconds_total Time the buzzer was on.\n"
+       << "# TYPE chip8_sound_seconds_total counter\n"
+       << "chip8_sound_seconds_total " << soundMicroseconds.load(std::memory_order_relaxed) / 1e6 << "\n"
+       << "# HELP chip8_trace_ring_entries Entries held in the instruction trace ring.\n"
+       << "# TYPE chip8_trace_ring_entries gauge\n"
+       << "chip8_trace_ring_entries " << traceOccupancy.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_trace_ring_capacity Capacity of the instruction trace ring.\n"
+       << "# TYPE chip8_trace_ring_capacity gauge\n"
+       << "chip8_trace_ring_capacity " << traceCapacity.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_host_cpu_ratio Process CPU time per wall-clock second.\n"
+       << "# TYPE chip8_host_cpu_ratio gauge\n"
+       << "chip8_host_cpu_ratio " << cpuUsage.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_display_refresh_hz Measured display refresh rate.\n"
+       << "# TYPE chip8_display_refresh_hz gauge\n"
+       << "chip8_display_refresh_hz " << refreshRate.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_present_jitter_seconds Mean deviation of present intervals from the refresh period.\n"
+       << "# TYPE chip8_present_jitter_seconds gauge\n"
+       << "chip8_present_jitter_seconds " << presentJitter.load(std::memory_order_relaxed) << "\n"
+       << "# HELP chip8_startup_seconds Start-up phase durations (audio and first_frame are measured from launch).\n"
+       << "# TYPE chip8_startup_seconds gauge\n";
+  const char *phases[STARTUP_PHASES] = { "window", "rom", "first_frame", "audio" };
+  for (int i = 0; i < STARTUP_PHASES; i++) {
+    body << "chip8_startup_seconds{phase=\"" << phases[i] << "\"} " << startup[i].load(std::memory_order_relaxed) << "\n";
+  }
+  body << "# HELP chip8_frame_time_seconds Host frame time over the last " << METRICS_FRAME_WINDOW << " frames.\n"
+       << "# TYPE chip8_frame_time_seconds summary\n";
+  for (double quantile : { 0.5, 0.9, 0.99 }) {
+    float value = samples.empty() ? 0.0f : samples[std::min<size_t>(quantile * samples.size(), samples.size() - 1)];
+    body << "chip8_frame_time_seconds{quantile=\"" << quantile << "\"} " << value << "\n";
+  }
+  body << "chip8_frame_time_seconds_sum " << frameTimeSum.load(std::memory_order_relaxed) << "\n"
+       << "chip8_frame_time_seconds_count " << hostFrameCount << "\n";
+  return body.str();
+}
+
+void Metrics::Stop() {
+  if (!serving) return;
+  serving = false;
+  server.join();
+  unlink(socketPath.c_str());
+}
+
+Metrics::~Metrics() {
+  Stop();
+}
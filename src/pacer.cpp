@@ -0,0 +1,51 @@
+#include "pacer.h"
+#include "scheduler.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+FramePacer::FramePacer() {
+  SetRefreshRate(PACER_DEFAULT_REFRESH);
+  lastPresent = 0;
+  jitter = 0;
+}
+
+void FramePacer::SetRefreshRate(int hz) {
+  if (hz <= 0) hz = PACER_DEFAULT_REFRESH;
+  refreshPeriod = NANOSECONDS / hz;
+}
+
+// Refines the refresh estimate from vsync-paced swaps and tracks how unevenly frames are presented.
+// Intervals far from the estimate (missed vblanks, window moves) only count towards jitter.
+void FramePacer::RecordPresent(uint64_t now, bool vsync) {
+  if (lastPresent) {
+    float deviation = float(now - lastPresent) - float(refreshPeriod);
+    jitter += (std::fabs(deviation) / NANOSECONDS - jitter) * PACER_SMOOTHING;
+    if (vsync && std::fabs(deviation) < refreshPeriod * PACER_REFRESH_TOLERANCE)
+      refreshPeriod += int64_t(deviation * PACER_SMOOTHING);
+  }
+  lastPresent = now;
+}
+
+// Next refresh on the cadence of the last present, skipping any that were already missed
+uint64_t FramePacer::NextPresent(uint64_t now) {
+  if (!lastPresent) return now;
+  uint64_t next = lastPresent + refreshPeriod;
+  if (next < now) next += ((now - next) / refreshPeriod + 1) * refreshPeriod;
+  return next;
+}
+
+// Sleeps for the bulk of the wait, then yields through the last stretch so presents stay evenly spaced
+void FramePacer::SleepUntilPresent() {
+  uint64_t now = Scheduler::Now();
+  uint64_t deadline = NextPresent(now);
+  if (deadline > now + SPIN_THRESHOLD)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now - SPIN_THRESHOLD));
+  while (Scheduler::Now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+float FramePacer::RefreshRate() {
+  return float(NANOSECONDS) / refreshPeriod;
+}
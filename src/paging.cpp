@@ -0,0 +1,93 @@
+#include "paging.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint8_t zeroPage[PAGE_SIZE] = {};
+
+PagedMemory::PagedMemory(uint32_t size) {
+  privatePages = 0;
+  Resize(size);
+}
+
+PagedMemory::PagedMemory(const PagedMemory &other) {
+  privatePages = 0;
+  *this = other;
+}
+
+// Shares the other memory's image and takes copies of its private pages
+PagedMemory &PagedMemory::operator=(const PagedMemory &other) {
+  if (this == &other) return *this;
+  image = other.image;
+  pages = other.pages;
+  owned.clear();
+  owned.resize(other.owned.size());
+  privatePages = other.privatePages;
+  for (std::size_t page = 0; page < owned.size(); page++) {
+    if (!other.owned[page]) continue;
+    owned[page] = std::make_unique<uint8_t[]>(PAGE_SIZE);
+    std::memcpy(owned[page].get(), other.owned[page].get(), PAGE_SIZE);
+    pages[page] = owned[page].get();
+  }
+  return *this;
+}
+
+const uint8_t *PagedMemory::SharedPage(uint32_t page) const {
+  std::size_t offset = std::size_t(page) << PAGE_BITS;
+  if (!image || offset + PAGE_SIZE > image->size()) return zeroPage;
+  return image->data() + offset;
+}
+
+// Copies a shared page into a private one on its first write
+uint8_t *PagedMemory::Privatize(uint32_t page) {
+  owned[page] = std::make_unique<uint8_t[]>(PAGE_SIZE);
+  std::memcpy(owned[page].get(), pages[page], PAGE_SIZE);
+  pages[page] = owned[page].get();
+  privatePages++;
+  return owned[page].get();
+}
+
+// Points every page back at `image`, dropping all private pages. Images are padded to whole pages.
+void PagedMemory::Map(MemoryImage image) {
+  this->image = std::move(image);
+  for (std::size_t page = 0; page < pages.size(); page++) {
+    owned[page].reset();
+    pages[page] = SharedPage(page);
+  }
+  privatePages = 0;
+}
+
+// Grows or shrinks the address space; pages that remain keep their contents
+void PagedMemory::Resize(uint32_t size) {
+  std::size_t count = size >> PAGE_BITS;
+  for (std::size_t page = count; page < owned.size(); page++) {
+    privatePages -= owned[page] != nullptr;
+  }
+  std::size_t old = pages.size();
+  pages.resize(count);
+  owned.resize(count);
+  for (std::size_t page = old; page < count; page++) {
+    pages[page] = SharedPage(page);
+  }
+}
+
+void PagedMemory::Read(uint32_t address, uint8_t *out, uint32_t count) const {
+  while (count) {
+    uint32_t chunk = std::min<uint32_t>(count, PAGE_SIZE - (address & PAGE_MASK));
+    std::memcpy(out, pages[address >> PAGE_BITS] + (address & PAGE_MASK), chunk);
+    address += chunk;
+    out += chunk;
+    count -= chunk;
+  }
+}
+
+void PagedMemory::Write(uint32_t address, const uint8_t *in, uint32_t count) {
+  while (count) {
+    uint32_t chunk = std::min<uint32_t>(count, PAGE_SIZE - (address & PAGE_MASK));
+    uint32_t page = address >> PAGE_BITS;
+    uint8_t *target = owned[page] ? owned[page].get() : Privatize(page);
+    std::memcpy(target + (address & PAGE_MASK), in, chunk);
+    address += chunk;
+    in += chunk;
+    count -= chunk;
+  }
+}
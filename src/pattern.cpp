@@ -0,0 +1,128 @@
+#include "pattern.h"
+#include "synth.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <vector>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+PatternSynth::PatternSynth(unsigned sampleRate) {
+  this->sampleRate = sampleRate;
+  std::fill(pattern, pattern + PATTERN_BYTES, 0);
+  pitch = PATTERN_DEFAULT_PITCH;
+  rateScale = 1.0;
+  position = 0;
+  mean = -1.0f;
+  level = 0;
+  gain = 0;
+  volume = 0;
+  std::fill(accumulator, accumulator + BLEP_TAPS * 2, 0.0f);
+  cursor = 0;
+  BuildResiduals();
+  UpdateIncrement();
+}
+
+// Tabulates band-limited step minus ideal step, for a step at each sub-sample offset in (0, 1)
+// after an output sample. Tap j covers output sample j - BLEP_TAPS / 2 + 1 relative to it.
+void PatternSynth::BuildResiduals() {
+  const int resolution = 256;
+  const int half = BLEP_TAPS / 2;
+  const double pi = std::numbers::pi;
+  // Running integral of a Blackman-windowed sinc across the window, normalised to a unit step
+  std::vector<double> step(BLEP_TAPS * resolution + 1, 0.0);
+  for (int i = 0; i < BLEP_TAPS * resolution; i++) {
+    double t = -half + (i + 0.5) / resolution;
+    double x = pi * 2.0 * BLEP_CUTOFF * t;
+    double window = 0.42 + 0.5 * std::cos(pi * t / half) + 0.08 * std::cos(2.0 * pi * t / half);
+    step[i + 1] = step[i] + std::sin(x) / x * window;
+  }
+  for (double &value : step) value /= step.back();
+
+  for (int phase = 0; phase < BLEP_PHASES; phase++) {
+    double offset = (phase + 0.5) / BLEP_PHASES;
+    for (int j = 0; j < BLEP_TAPS; j++) {
+      double t = j - half + 1 - offset;
+      int index = std::clamp(int(std::lround((t + half) * resolution)), 0, BLEP_TAPS * resolution);
+      residuals[phase][j] = step[index] - (t >= 0.0 ? 1.0 : 0.0);
+    }
+  }
+}
+
+void PatternSynth::UpdateIncrement() {
+  double rate = PATTERN_BASE_RATE * std::exp2((pitch - PATTERN_DEFAULT_PITCH) / 48.0);
+  increment = rate * rateScale / sampleRate;
+}
+
+void PatternSynth::SetPattern(const uint8_t *pattern) {
+  int ones = 0;
+  for (int i = 0; i < PATTERN_BYTES; i++) {
+    ones += std::popcount(pattern[i]);
+  }
+  std::copy(pattern, pattern + PATTERN_BYTES, this->pattern);
+  mean = 2.0f * ones / PATTERN_BITS - 1.0f;
+}
+
+void PatternSynth::SetPitch(uint8_t pitch) {
+  this->pitch = pitch;
+  UpdateIncrement();
+}
+
+// Follows the buzzer's dynamic rate control, like the square wave's pitch
+void PatternSynth::SetRateScale(double scale) {
+  if (scale == rateScale) return;
+  rateScale = scale;
+  UpdateIncrement();
+}
+
+void PatternSynth::SetVolume(float volume) {
+  this->volume = std::clamp(volume, 0.0f, 1.0f);
+}
+
+// Mixes a step of `delta` at `offset` (0, 1] of the way to the next output sample into the
+// accumulator, four taps at a time when SSE is available
+void PatternSynth::AddStep(float delta, double offset) {
+  const float *residual = residuals[std::min(int(offset * BLEP_PHASES), BLEP_PHASES - 1)];
+  float *target = accumulator + cursor;
+#ifdef __SSE__
+  __m128 scale = _mm_set1_ps(delta);
+  for (int j = 0; j < BLEP_TAPS; j += 4) {
+    _mm_storeu_ps(target + j, _mm_add_ps(_mm_loadu_ps(target + j), _mm_mul_ps(scale, _mm_load_ps(residual + j))));
+  }
+#else
+  for (int j = 0; j < BLEP_TAPS; j++) {
+    target[j] += delta * residual[j];
+  }
+#endif
+}
+
+float PatternSynth::Next(bool on) {
+  // Linear ramp towards the target gain, matching the square wave's fades
+  float target = on ? volume : 0.0f;
+  float step = 1.0f / SYNTH_FADE_SAMPLES;
+  gain = gain < target ? std::min(gain + step, target) : std::max(gain - step, target);
+
+  // Every bit boundary crossed before the next output sample may step the level
+  double end = position + increment;
+  for (double boundary = std::floor(position) + 1.0; boundary <= end; boundary++) {
+    int bit = int(boundary) % PATTERN_BITS;
+    float next = ((pattern[bit / 8] >> (7 - bit % 8)) & 1 ? 1.0f : -1.0f) - mean;
+    if (next == level) continue;
+    AddStep(next - level, (boundary - position) / increment);
+    level = next;
+  }
+  position = end >= PATTERN_BITS ? end - PATTERN_BITS : end;
+
+  // The held level lands half a residual later, where the steps above are centred
+  accumulator[cursor + BLEP_TAPS / 2] += level;
+  float value = accumulator[cursor];
+  if (++cursor == BLEP_TAPS) {
+    std::memcpy(accumulator, accumulator + BLEP_TAPS, sizeof(float) * BLEP_TAPS);
+    std::fill(accumulator + BLEP_TAPS, accumulator + BLEP_TAPS * 2, 0.0f);
+    cursor = 0;
+  }
+  return value * gain;
+}
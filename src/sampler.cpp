@@ -0,0 +1,70 @@
+#include "sampler.h"
+#include "synth.h"
+#include <algorithm>
+#include <cmath>
+
+Sampler::Sampler(unsigned sampleRate) {
+  this->sampleRate = sampleRate;
+  loop = false;
+  rate = 0;
+  rateScale = 1.0;
+  increment = 0;
+  position = 0;
+  gain = 0;
+  volume = 0;
+  last = 0;
+}
+
+void Sampler::UpdateIncrement() {
+  increment = rate * rateScale / sampleRate;
+}
+
+void Sampler::Play(SampleData data, unsigned rate, bool loop) {
+  this->data = std::move(data);
+  this->rate = rate;
+  this->loop = loop;
+  position = 0;
+  UpdateIncrement();
+}
+
+void Sampler::Stop() {
+  data.reset();
+}
+
+// Follows the buzzer's dynamic rate control, like the other sources
+void Sampler::SetRateScale(double scale) {
+  if (scale == rateScale) return;
+  rateScale = scale;
+  UpdateIncrement();
+}
+
+void Sampler::SetVolume(float volume) {
+  this->volume = std::clamp(volume, 0.0f, 1.0f);
+}
+
+float Sampler::Next() {
+  // Fades in on a new sample and out once it ends, matching the square wave's ramps
+  bool playing = data && !data->empty();
+  float target = playing ? volume : 0.0f;
+  float step = 1.0f / SYNTH_FADE_SAMPLES;
+  gain = gain < target ? std::min(gain + step, target) : std::max(gain - step, target);
+  // A stopped sample releases from the level it was cut at
+  if (!playing) return last * gain;
+
+  const std::vector<uint8_t> &samples = *data;
+  std::size_t index = std::size_t(position);
+  float fraction = float(position - index);
+  std::size_t next = index + 1 < samples.size() ? index + 1 : (loop ? 0 : index);
+  float a = (samples[index] - 128) / 128.0f;
+  float b = (samples[next] - 128) / 128.0f;
+  last = a + (b - a) * fraction;
+
+  position += increment;
+  if (position >= samples.size()) {
+    if (loop)
+      position = std::fmod(position, double(samples.size()));
+    else
+      Stop();
+  }
+  return last * gain;
+}
@@ -0,0 +1,88 @@
+#include "scheduler.h"
+#include <chrono>
+#include <thread>
+#include <time.h>
+
+Scheduler::Scheduler() {
+  epoch = 0;
+  step = 0;
+  frequency = STEP_FREQUENCY;
+  clockOffset = 0;
+  swapTime = 0;
+  sampleWallStart = 0;
+  sampleCpuStart = ProcessCpuTime();
+  cpuUsage = 0;
+}
+
+// Monotonic time in nanoseconds, immune to wall-clock adjustments
+uint64_t Scheduler::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Scheduler::Reset(uint64_t now, uint64_t frequency) {
+  this->frequency = frequency;
+  Resync(now);
+  sampleWallStart = now;
+  sampleCpuStart = ProcessCpuTime();
+}
+
+// Restarts the step grid at `now` (after a pause), keeping the timer phase
+void Scheduler::Resync(uint64_t now) {
+  epoch = now - (Deadline(step) - epoch);
+}
+
+// Deadline of a step, split so step * NANOSECONDS cannot overflow
+uint64_t Scheduler::Deadline(uint64_t step) {
+  return epoch + (step / frequency) * NANOSECONDS + (step % frequency) * NANOSECONDS / frequency;
+}
+
+// Returns how many steps are due at `now`. Steps more than MAX_CATCH_UP behind (e.g. after a
+// stall) are skipped whole, so the grid itself never moves.
+int Scheduler::DueSteps(uint64_t now, uint64_t *dropped) {
+  int steps = 0;
+  *dropped = 0;
+  while (steps < MAX_CATCH_UP && Deadline(step + steps + 1) <= now) {
+    steps++;
+  }
+  if (steps == MAX_CATCH_UP && Deadline(step + steps + 1) <= now) {
+    uint64_t behind = ((now - epoch) / NANOSECONDS) * frequency + ((now - epoch) % NANOSECONDS) * frequency / NANOSECONDS;
+    *dropped = behind - (step + steps);
+    step += *dropped;
+  }
+  return steps;
+}
+
+uint64_t Scheduler::TimeUntilStep(uint64_t now) {
+  uint64_t deadline = Deadline(step + 1);
+  return deadline > now ? deadline - now : 0;
+}
+
+// Sleeps for the bulk of the wait, then yields through the last stretch for sub-millisecond accuracy
+void Scheduler::SleepUntilStep() {
+  uint64_t deadline = Deadline(step + 1);
+  uint64_t remaining = TimeUntilStep(Clock());
+  if (remaining > SPIN_THRESHOLD)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - SPIN_THRESHOLD));
+  while (Clock() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+// Tracks how long buffer swaps block; a consistently blocking swap means vsync is pacing the loop
+void Scheduler::RecordSwap(float seconds) {
+  swapTime += (seconds - swapTime) * 0.1f;
+}
+
+void Scheduler::SampleCpuUsage(uint64_t now) {
+  if (now - sampleWallStart < CPU_SAMPLE_PERIOD) return;
+  uint64_t cpuNow = ProcessCpuTime();
+  cpuUsage = float(cpuNow - sampleCpuStart) / float(now - sampleWallStart);
+  sampleCpuStart = cpuNow;
+  sampleWallStart = now;
+}
+
+uint64_t Scheduler::ProcessCpuTime() {
+  timespec cpu;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+  return uint64_t(cpu.tv_sec) * NANOSECONDS + cpu.tv_nsec;
+}
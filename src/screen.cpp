@@ -14,11 +14,24 @@
 #include <vector>
 #include <iomanip>
 #include <algorithm>
+#include <bit>
 
 namespace fs = std::filesystem;
 
 void framebufferSizeCallback(GLFWwindow *window, int width, int height);
 
+// Planes are uploaded as raw DisplayRow memory, which the fragment shader reads as little-endian
+static_assert(std::endian::native == std::endian::little, "Plane upload assumes little-endian rows");
+
+// Indexed by plane bits: black and white for one plane, two greys added by XO-CHIP's second
+// plane, and a 16-colour set for four planes
+const float defaultPalette[PALETTE_SIZE][3] = {
+  { 0.00f, 0.00f, 0.00f }, { 1.00f, 1.00f, 1.00f }, { 0.67f, 0.67f, 0.67f }, { 0.33f, 0.33f, 0.33f },
+  { 0.67f, 0.00f, 0.00f }, { 0.00f, 0.67f, 0.00f }, { 0.00f, 0.00f, 0.67f }, { 0.67f, 0.67f, 0.00f },
+  { 0.67f, 0.00f, 0.67f }, { 0.00f, 0.67f, 0.67f }, { 1.00f, 0.33f, 0.33f }, { 0.33f, 1.00f, 0.33f },
+  { 0.33f, 0.33f, 1.00f }, { 1.00f, 1.00f, 0.33f }, { 1.00f, 0.33f, 1.00f }, { 0.33f, 1.00f, 1.00f }
+};
+
 Screen::Screen(const char *vsPath, const char *fsPath, Chip8 *chip8) {
   GLuint VBO;
   float plane[] = {
@@ -32,7 +45,6 @@ Screen::Screen(const char *vsPath, const char *fsPath, Chip8 *chip8) {
      1.0f,  1.0f, 1.0f, 1.0f
   };
   this->chip8 = chip8;
-  textureData = new std::vector<unsigned char>(DISPLAY_WIDTH * DISPLAY_HEIGHT * 4);
 
   // GLFW
   glfwInit();
@@ -49,6 +61,18 @@ Screen::Screen(const char *vsPath, const char *fsPath, Chip8 *chip8) {
   }
 
   glfwMakeContextCurrent(window);
+  // Lets buffer swaps pace presentation instead of the main loop spinning
+  glfwSwapInterval(1);
+  vsync = true;
+  swapTime = 0;
+  // Seed the pacer from the monitor's mode; measured swap intervals refine it from there
+  GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+  const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+  pacer.SetRefreshRate(mode ? mode->refreshRate : PACER_DEFAULT_REFRESH);
+  presentMode = PRESENT_REPEAT;
+  memset(frames, 0, sizeof(frames));
+  memcpy(palette, defaultPalette, sizeof(palette));
+  frameTime = 0;
 
   // GLAD
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -61,12 +85,28 @@ Screen::Screen(const char *vsPath, const char *fsPath, Chip8 *chip8) {
   // Shader
   shader = std::make_unique<Shader>(vsPath, fsPath);
 
-  // Texture
-  glGenTextures(1, &texture);
+  // Plane Texture (one byte per texel: both frames' planes, each a stack of bit-packed rows)
+  glGenTextures(1, &planeTexture);
   glActiveTexture(GL_TEXTURE0);
-  UpdateTextureData();
+  glBindTexture(GL_TEXTURE_2D, planeTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, DISPLAY_WIDTH / 8, 2 * DISPLAY_PLANES * DISPLAY_HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, frames);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // MegaChip Texture (the presented RGBA frame, streamed in while the MegaChip display is in)
+  glGenTextures(1, &megaTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, megaTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, MEGA_WIDTH, MEGA_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glActiveTexture(GL_TEXTURE0);
+
+  // Texture (the composited display, rendered into through the FBO; sized for the largest mode,
+  // with smaller modes drawn into its top-left corner)
+  glGenTextures(1, &texture);
   glBindTexture(GL_TEXTURE_2D, texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureData->data());
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, MEGA_WIDTH, MEGA_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
@@ -82,6 +122,15 @@ Screen::Screen(const char *vsPath, const char *fsPath, Chip8 *chip8) {
   }
   glBindTexture(GL_TEXTURE_2D, 0);
 
+  // Heatmap Texture
+  heatmapData.resize(HEATMAP_ADDRESSES * 4);
+  glGenTextures(1, &heatmapTexture);
+  glBindTexture(GL_TEXTURE_2D, heatmapTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, HEATMAP_SIZE, HEATMAP_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, heatmapData.data());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
   // Vertex Array
   glGenVertexArrays(1, &VAO);
   glBindVertexArray(VAO);
@@ -110,8 +159,6 @@ Screen::Screen(const char *vsPath, const char *fsPath, Chip8 *chip8) {
 }
 
 void Screen::Draw() {
-  glfwPollEvents();
-
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
@@ -119,17 +166,20 @@ void Screen::Draw() {
   // Draw to FBO
   glBindFramebuffer(GL_FRAMEBUFFER, FBO);
   glClear(GL_COLOR_BUFFER_BIT);
-  glViewport(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+  if (chip8->megaMode)
+    glViewport(0, 0, MEGA_WIDTH, MEGA_HEIGHT);
+  else
+    glViewport(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT);
   glBindVertexArray(VAO);
   shader->use();
-  shader->setInt("texSample", 0);
+  shader->setInt("planes", 0);
+  shader->setInt("megaFrame", 1);
   UpdateTextureData();
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, textureData->data());
   glDrawArrays(GL_TRIANGLES, 0, 6);
   GLenum err = glGetError();
   if (err != GL_NO_ERROR) std::cout << "GL Error: " << err << "\n";
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (!chip8->turboActive) UpdateHeatmapTexture();
 
   // Draw
   glViewport(0, 0, WIDTH, HEIGHT);
@@ -142,17 +192,72 @@ void Screen::Draw() {
   ImGui::Render();
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-  // Poll Events & Swap Buffers
+  // Swap Buffers
+  double swapStart = glfwGetTime();
   glfwSwapBuffers(window);
+  swapTime = glfwGetTime() - swapStart;
+  pacer.RecordPresent(Scheduler::Now(), vsync && chip8->scheduler.VsyncActive());
+}
+
+// Called on every emulated frame (timer tick) so presents between ticks can blend the last two
+void Screen::CaptureFrame(uint64_t now) {
+  memcpy(frames[1], frames[0], PLANE_BYTES);
+  memcpy(frames[0], chip8->state.planes, PLANE_BYTES);
+  frameTime = now;
+}
+
+void Screen::PollEvents() {
+  glfwPollEvents();
+}
+
+// Blocks until input arrives or the timeout expires
+void Screen::WaitEvents(double timeout) {
+  glfwWaitEventsTimeout(timeout);
+}
+
+void Screen::SetVsync(bool enabled) {
+  if (vsync == enabled) return;
+  glfwSwapInterval(enabled ? 1 : 0);
+  vsync = enabled;
 }
 
+bool Screen::Focused() {
+  return glfwGetWindowAttrib(window, GLFW_FOCUSED) && !glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+}
+
+// Uploads the bit-packed planes untouched; the fragment shader unpacks each pixel's plane bits
+// and looks them up in the palette. Repeat shows the live planes on every refresh. Interpolate
+// runs one emulated frame behind and fades from the previous frame to the latest across the
+// refreshes in between, so motion advances evenly even when the refresh rate isn't a multiple of 60 Hz.
+// The MegaChip display streams its last presented frame instead, faded by its screen alpha.
 void Screen::UpdateTextureData() {
-  for (unsigned int i = 0; i < DISPLAY_WIDTH * DISPLAY_HEIGHT; i++) {
-    (*textureData)[i * 4]     = chip8->display[i] * 255;
-    (*textureData)[i * 4 + 1] = chip8->display[i] * 255;
-    (*textureData)[i * 4 + 2] = chip8->display[i] * 255;
-    (*textureData)[i * 4 + 3] = 255;
+  shader->setInt("mega", chip8->megaMode);
+  if (chip8->megaMode) {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, megaTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MEGA_WIDTH, MEGA_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, chip8->mega.Frame());
+    glActiveTexture(GL_TEXTURE0);
+    shader->setFloat("megaAlpha", chip8->mega.Alpha() / 255.0f);
+    return;
+  }
+  bool interpolate = presentMode == PRESENT_INTERPOLATE && !chip8->paused && !chip8->turboActive;
+  float alpha = 1.0f;
+  glBindTexture(GL_TEXTURE_2D, planeTexture);
+  if (interpolate) {
+    alpha = std::clamp(float(Scheduler::Now() - frameTime) * TIMER_FREQUENCY / NANOSECONDS, 0.0f, 1.0f);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, DISPLAY_WIDTH / 8, 2 * DISPLAY_PLANES * DISPLAY_HEIGHT, GL_RED_INTEGER, GL_UNSIGNED_BYTE, frames);
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, DISPLAY_WIDTH / 8, DISPLAY_PLANES * DISPLAY_HEIGHT, GL_RED_INTEGER, GL_UNSIGNED_BYTE, chip8->state.planes);
   }
+  shader->setFloat("blend", alpha);
+  shader->setVector3fArray("palette", &palette[0][0], PALETTE_SIZE);
+}
+
+void Screen::UpdateHeatmapTexture() {
+  chip8->heatmap->FillRGBA(heatmapData.data());
+  glBindTexture(GL_TEXTURE_2D, heatmapTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, HEATMAP_SIZE, HEATMAP_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, heatmapData.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Screen::MenuBar() {
@@ -182,7 +287,8 @@ void Screen::Debugger() {
   static int stepCounter = 0;
   static int toggleHex = 1;
   static ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
-  int freq = static_cast<int>(chip8->instructionFrequency);
+  static uint64_t limitedRate = chip8->cyclesPerSecond;
+  static uint64_t rateStep = 60, rateStepFast = 6000;
 
   /* Chip8 Screen Window */
   static ImVec2 imageSize(int(WIDTH / 2), int(HEIGHT / 2));
@@ -190,9 +296,29 @@ void Screen::Debugger() {
   ImGui::SetNextWindowPos(ImVec2(WIDTH - screenSize.x, 19));
   ImGui::SetNextWindowSize(screenSize);
   ImGui::Begin("Screen");
-  ImGui::Image(texture, imageSize);
+  // Shows the corner of the FBO texture the current mode was drawn into, keeping its aspect
+  if (chip8->megaMode)
+    ImGui::Image(texture, ImVec2(imageSize.y * MEGA_WIDTH / MEGA_HEIGHT, imageSize.y));
+  else
+    ImGui::Image(texture, imageSize, ImVec2(0, 0), ImVec2(float(DISPLAY_WIDTH) / MEGA_WIDTH, float(DISPLAY_HEIGHT) / MEGA_HEIGHT));
   ImGui::End();
 
+  // Skip rebuilding the debugger while fast-forwarding; only the latest frame and a way out are shown
+  if (chip8->turboActive) {
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 19.0f));
+    ImGui::Begin("Turbo");
+    if (chip8->turboMax)
+      ImGui::TextUnformatted("Fast-forwarding as fast as possible");
+    else
+      ImGui::Text("Fast-forwarding at %dx", chip8->turboSpeed);
+    if (!chip8->turbo)
+      ImGui::TextUnformatted("Release Tab to stop");
+    else if (ImGui::Button("Stop Turbo"))
+      chip8->turbo = false;
+    ImGui::End();
+    return;
+  }
+
   /* Chip8 State Window */
   static ImVec2 stateSize(int(screenSize.x / 2), screenSize.y);
   std::stringstream opcodeStream, pcStream, I_Stream, keyStream, delayStream, soundStream, spStream;
@@ -202,7 +328,7 @@ void Screen::Debugger() {
   ImGui::RadioButton("Hex", &toggleHex, 1); ImGui::SameLine();
   ImGui::RadioButton("Decimal", &toggleHex, 0);
   // Initialize Chip8 States as String Streams
-  opcodeStream << "Opcode:        " << Utilities::FormatHex(4, chip8->opcode);
+  opcodeStream << "Opcode:        " << Utilities::FormatHex(4, chip8->state.opcode);
   pcStream     << "PC:            ";
   I_Stream     << "I:             ";
   keyStream    << "Key:           ";
@@ -211,25 +337,29 @@ void Screen::Debugger() {
   spStream     << "Stack Pointer: ";
   // Formats state information depending on user selection
   if (toggleHex) {
-    pcStream    << Utilities::FormatHex(3, chip8->pc);
-    I_Stream    << Utilities::FormatHex(3, chip8->I);
+    pcStream    << Utilities::FormatHex(3, chip8->state.pc);
+    I_Stream    << Utilities::FormatHex(3, chip8->state.I);
     keyStream   << Utilities::FormatHex(1, int(chip8->keyPressed));
-    delayStream << Utilities::FormatHex(2, int(chip8->delayTimer));
-    soundStream << Utilities::FormatHex(2, int(chip8->soundTimer));
-    spStream    << Utilities::FormatHex(2, int(chip8->sp));
+    delayStream << Utilities::FormatHex(2, int(chip8->state.delayTimer));
+    soundStream << Utilities::FormatHex(2, int(chip8->state.soundTimer));
+    spStream    << Utilities::FormatHex(2, int(chip8->state.sp));
   }
   else {
-    pcStream    << chip8->pc;
-    I_Stream    << chip8->I;
+    pcStream    << chip8->state.pc;
+    I_Stream    << chip8->state.I;
     keyStream   << int(chip8->keyPressed);
-    delayStream << int(chip8->delayTimer); 
-    soundStream << int(chip8->soundTimer); 
-    spStream    << int(chip8->sp);
+    delayStream << int(chip8->state.delayTimer); 
+    soundStream << int(chip8->state.soundTimer); 
+    spStream    << int(chip8->state.sp);
   }
   // Set Key Indicator to NONE if nothing is pressed
   if (chip8->keyPressed == -1) {
     keyStream.str("Key:           NONE");
   }
+  if (chip8->waitingForKey) {
+    keyStream.str("");
+    keyStream << "Key:           WAITING (V[" << Utilities::FormatHex(1, int(chip8->waitRegister)) << "])";
+  }
   // Displays Chip8 State as Formatted Strings
   ImGui::TextUnformatted(pcStream.str().c_str());
   ImGui::TextUnformatted(I_Stream.str().c_str());
@@ -237,6 +367,18 @@ void Screen::Debugger() {
   ImGui::TextUnformatted(delayStream.str().c_str());
   ImGui::TextUnformatted(soundStream.str().c_str());
   ImGui::TextUnformatted(opcodeStream.str().c_str());
+  ImGui::Text("Cycles:        %llu", (unsigned long long)chip8->cycles);
+  ImGui::Text("Host CPU:      %.1f%%", chip8->scheduler.CpuUsage() * 100.0f);
+  if (chip8->megaMode)
+    ImGui::Text("Mode:          MegaChip (256x192)");
+  else
+    ImGui::Text("Mode:          %s %s", chip8->xoChip ? "XO-CHIP" : chip8->superChip ? "SUPER-CHIP" : "CHIP-8", chip8->state.hires ? "(128x64)" : "(64x32)");
+  ImGui::Text("Planes:        %X", chip8->state.planeMask);
+  ImGui::Text("Written Pages: %u of %u", chip8->memory.PrivatePages(), chip8->memory.Size() / PAGE_SIZE);
+  ImGui::Text("Refresh:       %.1f Hz", pacer.RefreshRate());
+  ImGui::Text("Frame Jitter:  %.2f ms", pacer.Jitter() * 1000.0f);
+  ImGui::Text("Audio Rate:    %.4f", chip8->buzzer->Rate());
+  if (chip8->xoChip) ImGui::Text("Audio Pitch:   %d", chip8->audioPitch);
   // Displays V-Registers as a Table
   ImGui::SeparatorText("V-Registers");
   if (ImGui::BeginTable("Registers", 2, tableFlags)) {
@@ -249,9 +391,9 @@ void Screen::Debugger() {
       ImGui::Text("V[%.1X]", row);
       ImGui::TableNextColumn();
       if (toggleHex)
-        ImGui::Text("0x%.2X", chip8->V[row]);
+        ImGui::Text("0x%.2X", chip8->state.V[row]);
       else
-        ImGui::Text("%d", chip8->V[row]);
+        ImGui::Text("%d", chip8->state.V[row]);
     }
     ImGui::EndTable();
   }
@@ -266,18 +408,18 @@ void Screen::Debugger() {
     for (int i = 0; i < 16; i++) {
       ImGui::TableNextRow();
       ImGui::TableNextColumn();
-      if (i == chip8->sp - 1) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
+      if (i == chip8->state.sp - 1) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
       ImGui::Text("0x%.1X", i);
       ImGui::TableNextColumn();
-      if (i == chip8->sp - 1) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
-      ImGui::Text("0x%.3X", chip8->stack[i]);
+      if (i == chip8->state.sp - 1) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
+      ImGui::Text("0x%.3X", chip8->state.stack[i]);
     }
     ImGui::EndTable();
   }
   ImGui::End();
 
   /* Controls Window */
-  static char address[4] = "";
+  static char address[7] = "";
   static int jumpAddress = 0; 
   static bool jumped = false;
   static ImVec2 controlsSize = stateSize;
@@ -285,12 +427,73 @@ void Screen::Debugger() {
   ImGui::SetNextWindowSize(controlsSize);
   ImGui::Begin("Controls");
   ImGui::PushItemWidth(100.0f);
-  // Instruction Frequency Controls
-  ImGui::InputInt("Instruction Frequency", &freq);
-  chip8->instructionFrequency = freq;
+  // Clock Rate Controls
+  bool unlimited = chip8->cyclesPerSecond == UNLIMITED_CYCLES;
+  if (!unlimited) {
+    ImGui::InputScalar("Cycles per Second", ImGuiDataType_U64, &chip8->cyclesPerSecond, &rateStep, &rateStepFast);
+    ImGui::SetItemTooltip("Instructions executed per second (0 = unlimited)");
+    if (chip8->cyclesPerSecond != UNLIMITED_CYCLES) limitedRate = chip8->cyclesPerSecond;
+  }
+  if (ImGui::Checkbox("Unlimited", &unlimited))
+    chip8->cyclesPerSecond = unlimited ? UNLIMITED_CYCLES : limitedRate;
   // Controls for Steps per Button Click
   ImGui::InputInt("Step Count", &steps);
   ImGui::PopItemWidth();
+  // Turbo Controls (also active while Tab is held)
+  ImGui::Checkbox("Turbo", &chip8->turbo); ImGui::SameLine();
+  ImGui::SetNextItemWidth(100.0f);
+  ImGui::SliderInt("Turbo Speed", &chip8->turboSpeed, TURBO_MAX, 32, chip8->turboSpeed == TURBO_MAX ? "Max" : "%dx");
+  ImGui::SetItemTooltip("Emulated frames per real frame while fast-forwarding (0 = as fast as possible)");
+  // Idle Loop Fast-Forward
+  ImGui::Checkbox("Skip Idle Loops", &chip8->idleSkip);
+  ImGui::SetItemTooltip("Skips to the next timer tick when the ROM is polling the delay timer");
+  // Cycle-Accurate Timing (restart the budget from the current cycle count when enabled)
+  if (ImGui::Checkbox("COSMAC VIP Timing", &chip8->vipTiming))
+    chip8->cycleTarget = chip8->cycles;
+  ImGui::SetItemTooltip("Charges each instruction its VIP cycle cost and waits for vblank on DXYN");
+  // SUPER-CHIP Instructions (enabled automatically for .sc8 ROMs)
+  ImGui::Checkbox("SUPER-CHIP", &chip8->superChip);
+  ImGui::SetItemTooltip("Enables hi-res mode, scrolling, 16x16 sprites, the big font and RPL flags");
+  // XO-CHIP Instructions (enabled automatically for .xo8 ROMs; a superset of SUPER-CHIP)
+  if (ImGui::Checkbox("XO-CHIP", &chip8->xoChip) && chip8->xoChip)
+    chip8->superChip = true;
+  ImGui::SetItemTooltip("Enables 64 KB memory, long loads, bitplanes, register ranges and scrolling up");
+  // MegaChip Instructions (enabled automatically for .mc8 ROMs; a superset of SUPER-CHIP)
+  bool megaChip = chip8->megaChip;
+  if (ImGui::Checkbox("MegaChip", &megaChip)) {
+    chip8->SetMegaChip(megaChip);
+    if (megaChip) chip8->superChip = true;
+  }
+  ImGui::SetItemTooltip("Enables 16 MB memory, the 256x192 colour display, blended sprites and sampled sound");
+  // Quirk Profile (picked from the ROM's extension on load)
+  ImGui::SetNextItemWidth(150.0f);
+  if (ImGui::Combo("Quirks", &chip8->quirkProfile, "CHIP-8\0COSMAC VIP\0CHIP-48\0SUPER-CHIP\0XO-CHIP\0"))
+    chip8->SetQuirkProfile(chip8->quirkProfile);
+  ImGui::SetItemTooltip("Shift source, I after Fx55/Fx65, Bnnn/Bxnn, V[F] reset, sprite clipping and display wait (CHIP-8 and COSMAC VIP also run 0nnn machine code)");
+  // Palette (indexed by plane bits; entries past 3 are only reachable with four planes selected)
+  ImGui::Text("Palette:");
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    ImGui::PushID(i);
+    if (i % 8) ImGui::SameLine();
+    ImGui::ColorEdit3("##Palette", palette[i], ImGuiColorEditFlags_NoInputs);
+    ImGui::PopID();
+  }
+  // Presentation of 60 Hz frames on faster displays
+  ImGui::Text("Present:"); ImGui::SameLine();
+  ImGui::RadioButton("Repeat", &presentMode, PRESENT_REPEAT); ImGui::SameLine();
+  ImGui::RadioButton("Interpolate", &presentMode, PRESENT_INTERPOLATE);
+  ImGui::SetItemTooltip("Blends consecutive frames across refreshes (adds one frame of latency)");
+  // Audio-Master Sync
+  ImGui::Checkbox("Sync to Audio", &chip8->audioSync);
+  ImGui::SetItemTooltip("Paces emulation from the audio device's playback clock instead of the system clock");
+  // Buzzer Tone
+  float pitch = chip8->buzzer->Pitch(), volume = chip8->buzzer->Volume();
+  ImGui::SetNextItemWidth(100.0f);
+  if (ImGui::SliderFloat("Buzzer Pitch", &pitch, SYNTH_MIN_PITCH, 1000.0f, "%.0f Hz"))
+    chip8->buzzer->SetPitch(pitch);
+  ImGui::SetNextItemWidth(100.0f);
+  if (ImGui::SliderFloat("Volume", &volume, 0.0f, 1.0f, "%.2f"))
+    chip8->buzzer->SetVolume(volume);
   // Pause Button
   if (ImGui::Button("Pause")) {
     chip8->paused = !chip8->paused;
@@ -298,11 +501,11 @@ void Screen::Debugger() {
   // Step Button
   if (ImGui::Button("Step")) {
     if (chip8->paused) {
-      for (int i = 0; i < steps; i++) {
+      for (int i = 0; i < steps && !chip8->waitingForKey; i++) {
         // Ensures that timers are decremented at 60 HZ when paused 
         if (stepCounter % 60 == 0) {
-          chip8->soundTimer = chip8->soundTimer > 0 ? chip8->soundTimer - 1 : 0;
-          chip8->delayTimer = chip8->delayTimer > 0 ? chip8->delayTimer - 1 : 0;
+          chip8->state.soundTimer = chip8->state.soundTimer > 0 ? chip8->state.soundTimer - 1 : 0;
+          chip8->state.delayTimer = chip8->state.delayTimer > 0 ? chip8->state.delayTimer - 1 : 0;
         }
         chip8->EmulateCycle();
         stepCounter++;
@@ -313,11 +516,32 @@ void Screen::Debugger() {
   ImGui::Text("Jump to Address:"); ImGui::SameLine();
   ImGui::SetItemTooltip("Jumps to an address in the Memory window");
   ImGui::SetNextItemWidth(100.0f);
-  if (ImGui::InputTextWithHint("##Address", "<XXX>", address, 4, ImGuiInputTextFlags_EnterReturnsTrue)) {
+  if (ImGui::InputTextWithHint("##Address", "<XXXX>", address, sizeof(address), ImGuiInputTextFlags_EnterReturnsTrue)) {
     jumpAddress = std::stoi(address, 0, 16);
     jumped = true;
   }
-  ImGui::SetItemTooltip("Enter a 3-digit hexadecimal address");
+  ImGui::SetItemTooltip("Enter a hexadecimal address (up to 6 digits for MegaChip)");
+  // Memory Heatmap (one pixel per address, row-major)
+  static ImVec2 heatmapSize(256, 256);
+  ImGui::SeparatorText("Memory Heatmap");
+  ImGui::Image(heatmapTexture, heatmapSize);
+  if (ImGui::IsItemHovered()) {
+    ImVec2 origin = ImGui::GetItemRectMin();
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    int column = (mouse.x - origin.x) * HEATMAP_SIZE / heatmapSize.x;
+    int row = (mouse.y - origin.y) * HEATMAP_SIZE / heatmapSize.y;
+    int hovered = std::clamp(row, 0, HEATMAP_SIZE - 1) * HEATMAP_SIZE + std::clamp(column, 0, HEATMAP_SIZE - 1);
+    ImGui::SetTooltip("0x%.3X  X: %.2f  R: %.2f  W: %.2f", hovered,
+      chip8->heatmap->Intensity(HEAT_EXECUTE, hovered),
+      chip8->heatmap->Intensity(HEAT_READ, hovered),
+      chip8->heatmap->Intensity(HEAT_WRITE, hovered));
+    // Clicking a pixel jumps the Memory window to that address
+    if (ImGui::IsMouseClicked(0)) {
+      jumpAddress = hovered;
+      jumped = true;
+    }
+  }
+  ImGui::TextUnformatted("Blue: Execute  Green: Read  Red: Write");
   ImGui::End();
 
   /* Memory Window */
@@ -336,22 +560,35 @@ void Screen::Debugger() {
     ImGui::TableSetupColumn("Address");
     ImGui::TableSetupColumn("Value");
     ImGui::TableHeadersRow();
-    for (int i = 0; i < MEMORY; i++) {
-      bool cellJumped = i == jumpAddress;
-      bool cellActive = i == chip8->pc || i == chip8->pc + 1;
-      ImGui::TableNextRow();
-      // -- Address
-      ImGui::TableNextColumn();
-      // Highlight address if it was input
-      if (cellJumped) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, jumpColor);
-      // Highlight current PC memory location + next address
-      if (cellActive) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
-      ImGui::Text("0x%.3X", i);
-      // -- Value
-      ImGui::TableNextColumn();
-      if (cellJumped) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, jumpColor);
-      if (cellActive) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
-      ImGui::Text("0x%.2X", chip8->memory[i]);
+    // Only the visible rows are built; XO-CHIP memory is 64 KB and MegaChip memory 16 MB
+    ImGuiListClipper clipper;
+    clipper.Begin(chip8->AddressMask() + 1);
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+        bool cellJumped = i == jumpAddress;
+        bool cellActive = i == chip8->state.pc || i == chip8->state.pc + 1;
+        float executeHeat = chip8->heatmap->Intensity(HEAT_EXECUTE, i);
+        float readHeat = chip8->heatmap->Intensity(HEAT_READ, i);
+        float writeHeat = chip8->heatmap->Intensity(HEAT_WRITE, i);
+        float heat = std::max({ executeHeat, readHeat, writeHeat });
+        ImU32 heatColor = ImGui::GetColorU32(ImVec4(writeHeat, readHeat, executeHeat, heat * 0.6f));
+        ImGui::TableNextRow();
+        // -- Address
+        ImGui::TableNextColumn();
+        // Tint address by how often it was executed, read or written recently
+        if (heat > 0.01f) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, heatColor);
+        // Highlight address if it was input
+        if (cellJumped) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, jumpColor);
+        // Highlight current PC memory location + next address
+        if (cellActive) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
+        ImGui::Text("0x%.4X", i);
+        // -- Value
+        ImGui::TableNextColumn();
+        if (heat > 0.01f) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, heatColor);
+        if (cellJumped) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, jumpColor);
+        if (cellActive) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, activeColor);
+        ImGui::Text("0x%.2X", chip8->memory[i]);
+      }
     }
     ImGui::EndTable();
   }
@@ -371,7 +608,7 @@ void Screen::Debugger() {
 void Screen::PushToLog(std::string entry) {
   /*std::cout << entry << "\n";*/
   int size = debugLog.size();
-  if (size < 100) {
+  if (size < LOG_CAPACITY) {
     debugLog.push_back(entry);
   } else {
     std::rotate(debugLog.data(), debugLog.data() + 1, debugLog.data() + size);
@@ -384,11 +621,13 @@ void framebufferSizeCallback(GLFWwindow *window, int width, int height) {
 }
 
 Screen::~Screen() {
-  delete textureData;
   glDeleteFramebuffers(1, &FBO);
   glDeleteVertexArrays(1, &VAO);
   glDeleteShader(shader->getID());
   glDeleteTextures(1, &texture);
+  glDeleteTextures(1, &heatmapTexture);
+  glDeleteTextures(1, &planeTexture);
+  glDeleteTextures(1, &megaTexture);
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
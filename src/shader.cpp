@@ -67,6 +67,10 @@ void Shader::setVector3f(const char *uniform, glm::vec3 value) {
   glUniform3f(glGetUniformLocation(ID, uniform), value.x, value.y, value.z);
 }
 
+void Shader::setVector3fArray(const char *uniform, const float *values, int count) {
+  glUniform3fv(glGetUniformLocation(ID, uniform), count, values);
+}
+
 void Shader::setMatrix4(const char *uniform, glm::mat4 value) {
   glUniformMatrix4fv(glGetUniformLocation(ID, uniform), 1, GL_FALSE, &value[0][0]);
 }
@@ -0,0 +1,45 @@
+#include "synth.h"
+#include <algorithm>
+
+Synth::Synth(unsigned sampleRate) {
+  this->sampleRate = sampleRate;
+  phase = 0;
+  gain = 0;
+  volume = 0;
+  SetPitch(SYNTH_MIN_PITCH);
+}
+
+void Synth::SetPitch(float hz) {
+  increment = double(std::clamp(hz, SYNTH_MIN_PITCH, SYNTH_MAX_PITCH)) / sampleRate;
+}
+
+void Synth::SetVolume(float volume) {
+  this->volume = std::clamp(volume, 0.0f, 1.0f);
+}
+
+// Polynomial approximation of the band-limited step residual around a discontinuity at t = 0
+float Synth::PolyBLEP(double t, double dt) {
+  if (t < dt) {
+    t /= dt;
+    return t + t - t * t - 1.0;
+  }
+  if (t > 1.0 - dt) {
+    t = (t - 1.0) / dt;
+    return t * t + t + t + 1.0;
+  }
+  return 0.0f;
+}
+
+float Synth::Next(bool on) {
+  // Linear ramp towards the target gain, one full fade per SYNTH_FADE_SAMPLES
+  float target = on ? volume : 0.0f;
+  float step = 1.0f / SYNTH_FADE_SAMPLES;
+  gain = gain < target ? std::min(gain + step, target) : std::max(gain - step, target);
+
+  float value = phase < 0.5 ? 1.0f : -1.0f;
+  value += PolyBLEP(phase, increment);
+  value -= PolyBLEP(phase < 0.5 ? phase + 0.5 : phase - 0.5, increment);
+  phase += increment;
+  if (phase >= 1.0) phase -= 1.0;
+  return value * gain;
+}